@@ -0,0 +1,196 @@
+#include "AllocationCounter.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <ostream>
+
+#if defined(__GLIBC__) || defined(__APPLE__)
+#include <execinfo.h>
+#include <unistd.h>
+#define VECL_HAS_BACKTRACE 1
+#endif
+
+AllocationCounter allocationCounter;
+
+namespace
+{
+    const char* const sourceNames[AllocationCounter::SOURCE_COUNT] = {"heap", "Vulkan host"};
+
+    //set while a thread is printing a report, so whatever the report itself allocates isn't reported again.
+    thread_local bool reporting = false;
+    //set between beginFrame() and endFrame() on the thread recording the frame.
+    thread_local bool inFrame = false;
+}
+
+bool AllocationCounter::heapHookEnabled()
+{
+#ifdef VECL_COUNT_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+void AllocationCounter::record(Source source, size_t size)
+{
+    if(!inFrame || reporting)
+        return;
+
+    frameCounts[source].fetch_add(1, std::memory_order_relaxed);
+    frameBytes[source].fetch_add(size, std::memory_order_relaxed);
+
+    if(armed.load(std::memory_order_relaxed))
+    {
+        steadyCounts[source].fetch_add(1, std::memory_order_relaxed);
+        if(strict)
+            printStackTrace(source, size);
+    }
+}
+
+void AllocationCounter::beginFrame()
+{
+    for(int i = 0; i < SOURCE_COUNT; i++)
+    {
+        frameCounts[i].store(0, std::memory_order_relaxed);
+        frameBytes[i].store(0, std::memory_order_relaxed);
+    }
+    inFrame = true;
+}
+
+void AllocationCounter::endFrame()
+{
+    inFrame = false;
+
+    if(armed.load(std::memory_order_relaxed))
+    {
+        size_t heapCount = frameCounts[HEAP].load(std::memory_order_relaxed);
+        size_t hostCount = frameCounts[VULKAN_HOST].load(std::memory_order_relaxed);
+        if(strict && (heapCount > 0 || hostCount > 0))
+        {
+            reporting = true;
+            std::fprintf(stderr, "frame %llu allocated: %zu heap (%zu bytes), %zu Vulkan host (%zu bytes)\n",
+                         static_cast<unsigned long long>(frameIndex.load(std::memory_order_relaxed)), heapCount, frameBytes[HEAP].load(std::memory_order_relaxed),
+                         hostCount, frameBytes[VULKAN_HOST].load(std::memory_order_relaxed));
+            reporting = false;
+        }
+    }
+
+    if(frameIndex.fetch_add(1, std::memory_order_relaxed) + 1 == warmupFrames)
+    {
+#ifdef VECL_HAS_BACKTRACE
+        //the first backtrace() call loads the unwinder, which allocates, get that out of the way before arming.
+        void* warmup[1];
+        backtrace(warmup, 1);
+#endif
+        armed.store(true, std::memory_order_relaxed);
+    }
+}
+
+void AllocationCounter::printStackTrace(Source source, size_t size)
+{
+    reporting = true;
+    std::fprintf(stderr, "%s allocation of %zu bytes in frame %llu after warm up:\n", sourceNames[source], size,
+                 static_cast<unsigned long long>(frameIndex.load(std::memory_order_relaxed)));
+#ifdef VECL_HAS_BACKTRACE
+    //backtrace_symbols_fd writes straight to the fd instead of mallocing the strings.
+    void* frames[32];
+    int frameCount = backtrace(frames, 32);
+    backtrace_symbols_fd(frames, frameCount, STDERR_FILENO);
+#else
+    std::fprintf(stderr, "  (no stack traces on this platform)\n");
+#endif
+    reporting = false;
+}
+
+void AllocationCounter::printSummary(std::ostream& out) const
+{
+    out << "Allocations after " << warmupFrames << " warm up frames:";
+    for(int i = 0; i < SOURCE_COUNT; i++)
+    {
+        if(i == HEAP && !heapHookEnabled())
+            out << " " << sourceNames[i] << " not counted (configure with VECL_COUNT_ALLOCATIONS=ON),";
+        else
+            out << " " << sourceNames[i] << " " << steadyCounts[i].load(std::memory_order_relaxed) << ",";
+    }
+    uint64_t frames = frameIndex.load(std::memory_order_relaxed);
+    out << " over " << (frames > warmupFrames ? frames - warmupFrames : 0) << " frames" << std::endl;
+}
+
+#ifdef VECL_COUNT_ALLOCATIONS
+
+//the replacement global allocation functions, they only count and then hand off to malloc/free.
+
+void* operator new(std::size_t size)
+{
+    allocationCounter.record(AllocationCounter::HEAP, size);
+    void* memory = std::malloc(size != 0 ? size : 1);
+    if(memory == nullptr)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    allocationCounter.record(AllocationCounter::HEAP, size);
+    return std::malloc(size != 0 ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    allocationCounter.record(AllocationCounter::HEAP, size);
+    size_t align = static_cast<size_t>(alignment);
+    //aligned_alloc wants the size to be a multiple of the alignment.
+    size_t rounded = ((size != 0 ? size : 1) + align - 1) / align * align;
+    void* memory = std::aligned_alloc(align, rounded);
+    if(memory == nullptr)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    try
+    {
+        return operator new(size, alignment);
+    }
+    catch(const std::bad_alloc&)
+    {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t& tag) noexcept
+{
+    return operator new(size, alignment, tag);
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept { std::free(memory); }
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept { std::free(memory); }
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef VECL_ALLOCATIONCOUNTER_H
+#define VECL_ALLOCATIONCOUNTER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+
+//counts allocations made while a frame is running, to check the "no allocations per frame once warmed up" goal.
+//the Vulkan host callbacks always report here, global operator new/delete only do when the project is configured with
+//VECL_COUNT_ALLOCATIONS=ON (replacing them costs a little on every allocation, so it's off by default).
+//in strict mode every allocation after warm up prints a stack trace on the spot.
+class AllocationCounter
+{
+public:
+    enum Source
+    {
+        //operator new/delete.
+        HEAP = 0,
+        //the VkAllocationCallbacks in HostAllocator.
+        VULKAN_HOST = 1,
+        SOURCE_COUNT = 2
+    };
+
+    //true when the global operator new/delete hooks are compiled in.
+    static bool heapHookEnabled();
+
+    //safe to call from any thread and from inside operator new.
+    void record(Source source, size_t size);
+
+    //only allocations made on the thread that calls these count against the frame, the threads running next to it
+    //(window events, simulation, submission, pipeline compiles) aren't part of it.
+    void beginFrame();
+    //closes the frame, after the warm up frames are over this reports anything that was allocated during it.
+    void endFrame();
+
+    //how many frames are allowed to allocate (loading, first use of everything) before counting starts.
+    void setWarmupFrames(uint64_t frames) { warmupFrames = frames; }
+    void setStrict(bool enabled) { strict = enabled; }
+
+    size_t frameAllocations(Source source) const { return frameCounts[source].load(std::memory_order_relaxed); }
+    //allocations made during frames after warm up, should stay 0.
+    size_t steadyStateAllocations(Source source) const { return steadyCounts[source].load(std::memory_order_relaxed); }
+
+    void printSummary(std::ostream& out) const;
+
+private:
+    void printStackTrace(Source source, size_t size);
+
+    //all of this has to be usable before any constructor runs, operator new can be called during static initialization.
+    std::atomic<size_t> frameCounts[SOURCE_COUNT] = {};
+    std::atomic<size_t> frameBytes[SOURCE_COUNT] = {};
+    std::atomic<size_t> steadyCounts[SOURCE_COUNT] = {};
+    std::atomic<bool> armed{false};
+    //read by the strict mode reports on whatever thread allocates.
+    std::atomic<uint64_t> frameIndex{0};
+    uint64_t warmupFrames = 120;
+    bool strict = false;
+};
+
+extern AllocationCounter allocationCounter;
+
+#endif //VECL_ALLOCATIONCOUNTER_H
@@ -0,0 +1,247 @@
+#include "BindlessHeap.h"
+
+#include "DeviceFeatures.h"
+#include "HostAllocator.h"
+
+#include <algorithm>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    const char* tableNames[] = {"sampler", "buffer", "image"};
+}
+
+bool BindlessHeap::init(VkDevice device, VkPhysicalDevice physicalDevice, DescriptorLayoutCache& layouts,
+                        uint32_t maxImages, uint32_t maxBuffers, uint32_t maxSamplers)
+{
+    this->device = device;
+    if(!capabilities.descriptorIndexing)
+        return false;
+
+    //update after bind descriptors have their own (much higher) limits, the plain per stage ones don't apply.
+    VkPhysicalDeviceDescriptorIndexingProperties indexingProperties = {};
+    indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties2 = {};
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties2.pNext = &indexingProperties;
+    vkd.vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+
+    tables[SAMPLERS].capacity = std::min({maxSamplers, indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers,
+                                          indexingProperties.maxDescriptorSetUpdateAfterBindSamplers});
+    tables[BUFFERS].capacity = std::min({maxBuffers, indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+                                         indexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers});
+    tables[IMAGES].capacity = std::min({maxImages, indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                                        indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages});
+    //every stage sees the whole set, so the tables together also have to fit into one stage.
+    uint32_t resources = indexingProperties.maxPerStageUpdateAfterBindResources;
+    if(tables[SAMPLERS].capacity + tables[BUFFERS].capacity + tables[IMAGES].capacity > resources)
+        tables[IMAGES].capacity = resources > tables[SAMPLERS].capacity + tables[BUFFERS].capacity
+                                      ? resources - tables[SAMPLERS].capacity - tables[BUFFERS].capacity
+                                      : 0;
+    for(const Slots& slots : tables)
+    {
+        if(slots.capacity == 0)
+            return false;
+    }
+
+    VkDescriptorSetLayoutBinding bindings[TABLE_COUNT] = {};
+    bindings[SAMPLERS].binding = SAMPLER_BINDING;
+    bindings[SAMPLERS].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+    bindings[BUFFERS].binding = BUFFER_BINDING;
+    bindings[BUFFERS].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[IMAGES].binding = IMAGE_BINDING;
+    bindings[IMAGES].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+
+    //partially bound: slots nothing was written to yet (or that were removed) are fine as long as no shader reads them.
+    //update unused while pending: new resources can be written while frames using the set are still in flight.
+    VkDescriptorBindingFlags bindingFlags[TABLE_COUNT];
+    for(int i = 0; i < TABLE_COUNT; i++)
+    {
+        bindings[i].descriptorCount = tables[i].capacity;
+        bindings[i].stageFlags = VK_SHADER_STAGE_ALL;
+        bindingFlags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                          VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    }
+    bindingFlags[IMAGES] |= VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT;
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo = {};
+    flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    flagsInfo.bindingCount = TABLE_COUNT;
+    flagsInfo.pBindingFlags = bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = &flagsInfo;
+    layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layoutInfo.bindingCount = TABLE_COUNT;
+    layoutInfo.pBindings = bindings;
+    setLayout = layouts.get(layoutInfo);
+
+    VkDescriptorPoolSize sizes[TABLE_COUNT];
+    for(int i = 0; i < TABLE_COUNT; i++)
+    {
+        sizes[i].type = bindings[i].descriptorType;
+        sizes[i].descriptorCount = tables[i].capacity;
+    }
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = TABLE_COUNT;
+    poolInfo.pPoolSizes = sizes;
+    if(vkd.vkCreateDescriptorPool(device, &poolInfo, hostAllocator.callbacks(), &pool) != VK_SUCCESS)
+        throw std::runtime_error("failed to create the bindless descriptor pool.");
+
+    VkDescriptorSetVariableDescriptorCountAllocateInfo countInfo = {};
+    countInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+    countInfo.descriptorSetCount = 1;
+    countInfo.pDescriptorCounts = &tables[IMAGES].capacity;
+
+    VkDescriptorSetAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocateInfo.pNext = &countInfo;
+    allocateInfo.descriptorPool = pool;
+    allocateInfo.descriptorSetCount = 1;
+    allocateInfo.pSetLayouts = &setLayout;
+    if(vkd.vkAllocateDescriptorSets(device, &allocateInfo, &set) != VK_SUCCESS)
+        throw std::runtime_error("failed to allocate the bindless descriptor set.");
+
+    return true;
+}
+
+void BindlessHeap::destroy()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    //the layout belongs to the layout cache, the set goes away with its pool.
+    if(pool != VK_NULL_HANDLE)
+        vkd.vkDestroyDescriptorPool(device, pool, hostAllocator.callbacks());
+    pool = VK_NULL_HANDLE;
+    set = VK_NULL_HANDLE;
+    setLayout = VK_NULL_HANDLE;
+    for(Slots& slots : tables)
+        slots = Slots();
+    removals.clear();
+}
+
+uint32_t BindlessHeap::addImage(VkImageView view, VkImageLayout layout)
+{
+    VkDescriptorImageInfo imageInfo = {};
+    imageInfo.imageView = view;
+    imageInfo.imageLayout = layout;
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstBinding = IMAGE_BINDING;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    write.pImageInfo = &imageInfo;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    write.dstArrayElement = grabSlot(IMAGES);
+    this->write(write);
+    return write.dstArrayElement;
+}
+
+uint32_t BindlessHeap::addBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+    VkDescriptorBufferInfo bufferInfo = {};
+    bufferInfo.buffer = buffer;
+    bufferInfo.offset = offset;
+    bufferInfo.range = range;
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstBinding = BUFFER_BINDING;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = &bufferInfo;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    write.dstArrayElement = grabSlot(BUFFERS);
+    this->write(write);
+    return write.dstArrayElement;
+}
+
+uint32_t BindlessHeap::addSampler(VkSampler sampler)
+{
+    VkDescriptorImageInfo samplerInfo = {};
+    samplerInfo.sampler = sampler;
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstBinding = SAMPLER_BINDING;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+    write.pImageInfo = &samplerInfo;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    write.dstArrayElement = grabSlot(SAMPLERS);
+    this->write(write);
+    return write.dstArrayElement;
+}
+
+void BindlessHeap::collect(uint64_t completedFrame)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    //free what is done and slide the rest to the front.
+    size_t kept = 0;
+    for(const Removal& removal : removals)
+    {
+        if(removal.lastUsedFrame <= completedFrame)
+            tables[removal.table].free.push_back(removal.index);
+        else
+            removals[kept++] = removal;
+    }
+    removals.resize(kept);
+}
+
+void BindlessHeap::printReport(std::ostream& out) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if(set == VK_NULL_HANDLE)
+    {
+        out << "Bindless heap: not available" << std::endl;
+        return;
+    }
+
+    out << "Bindless heap:";
+    for(int i = 0; i < TABLE_COUNT; i++)
+    {
+        const Slots& slots = tables[i];
+        out << (i == 0 ? " " : ", ") << tableNames[i] << "s " << slots.next - slots.free.size() << "/" << slots.capacity;
+    }
+    out << " (" << removals.size() << " waiting for their frame)" << std::endl;
+}
+
+uint32_t BindlessHeap::grabSlot(Table table)
+{
+    if(set == VK_NULL_HANDLE)
+        throw std::runtime_error("bindless heap used without descriptor indexing.");
+
+    Slots& slots = tables[table];
+    if(!slots.free.empty())
+    {
+        uint32_t index = slots.free.back();
+        slots.free.pop_back();
+        return index;
+    }
+    if(slots.next == slots.capacity)
+        throw std::runtime_error(std::string("bindless ") + tableNames[table] + " table is full.");
+    return slots.next++;
+}
+
+void BindlessHeap::write(const VkWriteDescriptorSet& write)
+{
+    VkWriteDescriptorSet target = write;
+    target.dstSet = set;
+    vkd.vkUpdateDescriptorSets(device, 1, &target, 0, nullptr);
+}
+
+void BindlessHeap::remove(Table table, uint32_t index, uint64_t lastUsedFrame)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    removals.push_back({table, index, lastUsedFrame});
+}
@@ -0,0 +1,89 @@
+#ifndef VECL_BINDLESSHEAP_H
+#define VECL_BINDLESSHEAP_H
+
+#include "VulkanDispatch.h"
+#include "DescriptorAllocator.h"
+
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <vector>
+
+//one descriptor set for the whole renderer with big arrays of samplers, storage buffers and sampled images. resources
+//are written into it once when they are created and shaders index the arrays with the handle they get through push
+//constants or buffers, so drawing never binds per material descriptor sets. bound once per command buffer, at the set
+//index the pipeline layouts give it (BINDLESS_SET in main.cpp).
+//needs capabilities.descriptorIndexing, without it init() returns false and the renderer keeps using per draw sets.
+//safe to use from any thread.
+class BindlessHeap
+{
+public:
+    static const uint32_t SAMPLER_BINDING = 0;
+    static const uint32_t BUFFER_BINDING = 1;
+    //the last binding so it can be the variable sized one, shaders declare it as an unsized array.
+    static const uint32_t IMAGE_BINDING = 2;
+
+    //creates the layout (through "layouts") and the set, the tables are clamped to what the device allows.
+    bool init(VkDevice device, VkPhysicalDevice physicalDevice, DescriptorLayoutCache& layouts,
+              uint32_t maxImages = 16384, uint32_t maxBuffers = 8192, uint32_t maxSamplers = 256);
+    void destroy();
+
+    bool available() const { return set != VK_NULL_HANDLE; }
+    VkDescriptorSetLayout layout() const { return setLayout; }
+    VkDescriptorSet descriptorSet() const { return set; }
+
+    //writes the resource into a free slot and returns its index, throws once the table is full.
+    uint32_t addImage(VkImageView view, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    uint32_t addBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+    uint32_t addSampler(VkSampler sampler);
+
+    //gives the slot back once "lastUsedFrame" has completed, frames still in flight may index it until then.
+    void removeImage(uint32_t index, uint64_t lastUsedFrame) { remove(IMAGES, index, lastUsedFrame); }
+    void removeBuffer(uint32_t index, uint64_t lastUsedFrame) { remove(BUFFERS, index, lastUsedFrame); }
+    void removeSampler(uint32_t index, uint64_t lastUsedFrame) { remove(SAMPLERS, index, lastUsedFrame); }
+
+    //frees the slots of everything removed at or before "completedFrame", call it next to DeletionQueue::collect.
+    void collect(uint64_t completedFrame);
+
+    void printReport(std::ostream& out) const;
+
+private:
+    enum Table
+    {
+        SAMPLERS,
+        BUFFERS,
+        IMAGES,
+        TABLE_COUNT
+    };
+
+    struct Slots
+    {
+        uint32_t capacity = 0;
+        //slots below this have been handed out at least once, the ones above it were never touched.
+        uint32_t next = 0;
+        std::vector<uint32_t> free;
+    };
+
+    struct Removal
+    {
+        Table table;
+        uint32_t index;
+        uint64_t lastUsedFrame;
+    };
+
+    uint32_t grabSlot(Table table);
+    void write(const VkWriteDescriptorSet& write);
+    void remove(Table table, uint32_t index, uint64_t lastUsedFrame);
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    VkDescriptorSet set = VK_NULL_HANDLE;
+
+    //guards the slots and the set itself, vkUpdateDescriptorSets on one set has to be externally synchronized.
+    mutable std::mutex mutex;
+    Slots tables[TABLE_COUNT];
+    std::vector<Removal> removals;
+};
+
+#endif //VECL_BINDLESSHEAP_H
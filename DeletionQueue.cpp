@@ -0,0 +1,98 @@
+#include "DeletionQueue.h"
+
+#include "VulkanDispatch.h"
+#include "HostAllocator.h"
+#include "DeviceMemory.h"
+
+void DeletionQueue::push(VkObjectType type, uint64_t handle, uint64_t lastUsedFrame)
+{
+    if(handle == 0)
+        return;
+
+    entries.push_back({type, handle, lastUsedFrame});
+}
+
+void DeletionQueue::collect(VkDevice device, uint64_t completedFrame)
+{
+    //destroy what is done and slide the rest to the front, keeping the order they were queued in.
+    size_t kept = 0;
+    for(size_t i = 0; i < entries.size(); i++)
+    {
+        if(entries[i].lastUsedFrame <= completedFrame)
+            destroy(device, entries[i]);
+        else
+            entries[kept++] = entries[i];
+    }
+    entries.resize(kept);
+}
+
+void DeletionQueue::flush(VkDevice device)
+{
+    for(const Entry& entry : entries)
+        destroy(device, entry);
+    entries.clear();
+}
+
+void DeletionQueue::destroy(VkDevice device, const Entry& entry)
+{
+    switch(entry.type)
+    {
+        case VK_OBJECT_TYPE_BUFFER:
+            vkd.vkDestroyBuffer(device, (VkBuffer)entry.handle, hostAllocator.callbacks());
+            break;
+        case VK_OBJECT_TYPE_BUFFER_VIEW:
+            vkd.vkDestroyBufferView(device, (VkBufferView)entry.handle, hostAllocator.callbacks());
+            break;
+        case VK_OBJECT_TYPE_IMAGE:
+            vkd.vkDestroyImage(device, (VkImage)entry.handle, hostAllocator.callbacks());
+            break;
+        case VK_OBJECT_TYPE_IMAGE_VIEW:
+            vkd.vkDestroyImageView(device, (VkImageView)entry.handle, hostAllocator.callbacks());
+            break;
+        case VK_OBJECT_TYPE_DEVICE_MEMORY:
+            //through the memory manager so the accounting sees it go.
+            deviceMemory.free((VkDeviceMemory)entry.handle);
+            break;
+        case VK_OBJECT_TYPE_SAMPLER:
+            vkd.vkDestroySampler(device, (VkSampler)entry.handle, hostAllocator.callbacks());
+            break;
+        case VK_OBJECT_TYPE_PIPELINE:
+            vkd.vkDestroyPipeline(device, (VkPipeline)entry.handle, hostAllocator.callbacks());
+            break;
+        case VK_OBJECT_TYPE_PIPELINE_LAYOUT:
+            vkd.vkDestroyPipelineLayout(device, (VkPipelineLayout)entry.handle, hostAllocator.callbacks());
+            break;
+        case VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT:
+            vkd.vkDestroyDescriptorSetLayout(device, (VkDescriptorSetLayout)entry.handle, hostAllocator.callbacks());
+            break;
+        case VK_OBJECT_TYPE_DESCRIPTOR_POOL:
+            vkd.vkDestroyDescriptorPool(device, (VkDescriptorPool)entry.handle, hostAllocator.callbacks());
+            break;
+        case VK_OBJECT_TYPE_COMMAND_POOL:
+            vkd.vkDestroyCommandPool(device, (VkCommandPool)entry.handle, hostAllocator.callbacks());
+            break;
+        case VK_OBJECT_TYPE_SHADER_MODULE:
+            vkd.vkDestroyShaderModule(device, (VkShaderModule)entry.handle, hostAllocator.callbacks());
+            break;
+        case VK_OBJECT_TYPE_RENDER_PASS:
+            vkd.vkDestroyRenderPass(device, (VkRenderPass)entry.handle, hostAllocator.callbacks());
+            break;
+        case VK_OBJECT_TYPE_FRAMEBUFFER:
+            vkd.vkDestroyFramebuffer(device, (VkFramebuffer)entry.handle, hostAllocator.callbacks());
+            break;
+        case VK_OBJECT_TYPE_SEMAPHORE:
+            vkd.vkDestroySemaphore(device, (VkSemaphore)entry.handle, hostAllocator.callbacks());
+            break;
+        case VK_OBJECT_TYPE_FENCE:
+            vkd.vkDestroyFence(device, (VkFence)entry.handle, hostAllocator.callbacks());
+            break;
+        case VK_OBJECT_TYPE_QUERY_POOL:
+            vkd.vkDestroyQueryPool(device, (VkQueryPool)entry.handle, hostAllocator.callbacks());
+            break;
+        case VK_OBJECT_TYPE_EVENT:
+            vkd.vkDestroyEvent(device, (VkEvent)entry.handle, hostAllocator.callbacks());
+            break;
+        default:
+            break;
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef VECL_DELETIONQUEUE_H
+#define VECL_DELETIONQUEUE_H
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+//holds on to Vulkan objects that are no longer wanted but might still be used by frames the GPU hasn't finished yet.
+//every object is tagged with the number of the last frame that used it and only gets destroyed once that frame's fence
+//has signaled, so freeing something never needs a vkDeviceWaitIdle.
+class DeletionQueue
+{
+public:
+    //queue an object for destruction after "lastUsedFrame" has completed on the GPU.
+    void push(VkBuffer buffer, uint64_t lastUsedFrame) { push(VK_OBJECT_TYPE_BUFFER, toHandle(buffer), lastUsedFrame); }
+    void push(VkBufferView view, uint64_t lastUsedFrame) { push(VK_OBJECT_TYPE_BUFFER_VIEW, toHandle(view), lastUsedFrame); }
+    void push(VkImage image, uint64_t lastUsedFrame) { push(VK_OBJECT_TYPE_IMAGE, toHandle(image), lastUsedFrame); }
+    void push(VkImageView view, uint64_t lastUsedFrame) { push(VK_OBJECT_TYPE_IMAGE_VIEW, toHandle(view), lastUsedFrame); }
+    void push(VkDeviceMemory memory, uint64_t lastUsedFrame) { push(VK_OBJECT_TYPE_DEVICE_MEMORY, toHandle(memory), lastUsedFrame); }
+    void push(VkSampler sampler, uint64_t lastUsedFrame) { push(VK_OBJECT_TYPE_SAMPLER, toHandle(sampler), lastUsedFrame); }
+    void push(VkPipeline pipeline, uint64_t lastUsedFrame) { push(VK_OBJECT_TYPE_PIPELINE, toHandle(pipeline), lastUsedFrame); }
+    void push(VkPipelineLayout layout, uint64_t lastUsedFrame) { push(VK_OBJECT_TYPE_PIPELINE_LAYOUT, toHandle(layout), lastUsedFrame); }
+    void push(VkDescriptorSetLayout layout, uint64_t lastUsedFrame) { push(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT, toHandle(layout), lastUsedFrame); }
+    void push(VkDescriptorPool pool, uint64_t lastUsedFrame) { push(VK_OBJECT_TYPE_DESCRIPTOR_POOL, toHandle(pool), lastUsedFrame); }
+    void push(VkCommandPool pool, uint64_t lastUsedFrame) { push(VK_OBJECT_TYPE_COMMAND_POOL, toHandle(pool), lastUsedFrame); }
+    void push(VkShaderModule module, uint64_t lastUsedFrame) { push(VK_OBJECT_TYPE_SHADER_MODULE, toHandle(module), lastUsedFrame); }
+    void push(VkRenderPass renderPass, uint64_t lastUsedFrame) { push(VK_OBJECT_TYPE_RENDER_PASS, toHandle(renderPass), lastUsedFrame); }
+    void push(VkFramebuffer framebuffer, uint64_t lastUsedFrame) { push(VK_OBJECT_TYPE_FRAMEBUFFER, toHandle(framebuffer), lastUsedFrame); }
+    void push(VkSemaphore semaphore, uint64_t lastUsedFrame) { push(VK_OBJECT_TYPE_SEMAPHORE, toHandle(semaphore), lastUsedFrame); }
+    void push(VkFence fence, uint64_t lastUsedFrame) { push(VK_OBJECT_TYPE_FENCE, toHandle(fence), lastUsedFrame); }
+    void push(VkQueryPool pool, uint64_t lastUsedFrame) { push(VK_OBJECT_TYPE_QUERY_POOL, toHandle(pool), lastUsedFrame); }
+    void push(VkEvent event, uint64_t lastUsedFrame) { push(VK_OBJECT_TYPE_EVENT, toHandle(event), lastUsedFrame); }
+
+    //destroys everything whose last frame is at or before "completedFrame", call it right after waiting on a frame fence.
+    void collect(VkDevice device, uint64_t completedFrame);
+
+    //destroys everything that is left, only call this once the GPU is known to be idle (shutdown).
+    void flush(VkDevice device);
+
+    size_t pending() const { return entries.size(); }
+
+private:
+    struct Entry
+    {
+        VkObjectType type;
+        uint64_t handle;
+        uint64_t lastUsedFrame;
+    };
+
+    //non-dispatchable handles are pointers on 64 bit platforms and uint64_t everywhere else, a C style cast handles both.
+    template<typename T>
+    static uint64_t toHandle(T handle) { return (uint64_t)handle; }
+
+    void push(VkObjectType type, uint64_t handle, uint64_t lastUsedFrame);
+    static void destroy(VkDevice device, const Entry& entry);
+
+    //kept around between collects so its storage gets reused instead of reallocated every frame.
+    std::vector<Entry> entries;
+};
+
+#endif //VECL_DELETIONQUEUE_H
@@ -0,0 +1,245 @@
+#include "DescriptorAllocator.h"
+
+#include "HostAllocator.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+namespace
+{
+    const uint32_t NO_IMMUTABLE_SAMPLERS = UINT32_MAX;
+    //pools stop growing here, a pool this big is already more than a frame should ever need.
+    const uint32_t MAX_SETS_PER_POOL = 4096;
+
+    //how many descriptors of each type a pool gets per set it can hold, a guess at what an average set looks like.
+    //a pool runs out when either the sets or one of these run out, the allocator just moves on to the next pool.
+    struct PoolRatio
+    {
+        VkDescriptorType type;
+        float perSet;
+    };
+
+    const PoolRatio poolRatios[] = {
+        {VK_DESCRIPTOR_TYPE_SAMPLER, 0.5f},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f},
+        {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 4.0f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, 1.0f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, 1.0f},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.0f},
+        {VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 0.5f},
+    };
+    const size_t POOL_RATIO_COUNT = sizeof(poolRatios) / sizeof(poolRatios[0]);
+
+    void hashCombine(size_t& seed, size_t value)
+    {
+        seed ^= value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+    }
+}
+
+bool DescriptorLayoutCache::Binding::operator==(const Binding& other) const
+{
+    return binding == other.binding && type == other.type && count == other.count && stages == other.stages &&
+           flags == other.flags && firstImmutableSampler == other.firstImmutableSampler;
+}
+
+bool DescriptorLayoutCache::Key::operator==(const Key& other) const
+{
+    return flags == other.flags && bindings == other.bindings && immutableSamplers == other.immutableSamplers;
+}
+
+size_t DescriptorLayoutCache::KeyHash::operator()(const Key& key) const
+{
+    size_t seed = std::hash<uint32_t>()(key.flags);
+    for(const Binding& binding : key.bindings)
+    {
+        hashCombine(seed, binding.binding);
+        hashCombine(seed, static_cast<size_t>(binding.type));
+        hashCombine(seed, binding.count);
+        hashCombine(seed, binding.stages);
+        hashCombine(seed, binding.flags);
+    }
+    for(VkSampler sampler : key.immutableSamplers)
+        hashCombine(seed, std::hash<uint64_t>()((uint64_t)sampler));
+    return seed;
+}
+
+void DescriptorLayoutCache::init(VkDevice device)
+{
+    this->device = device;
+}
+
+void DescriptorLayoutCache::destroy()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for(auto& entry : layouts)
+        vkd.vkDestroyDescriptorSetLayout(device, entry.second, hostAllocator.callbacks());
+    layouts.clear();
+}
+
+VkDescriptorSetLayout DescriptorLayoutCache::get(const VkDescriptorSetLayoutCreateInfo& createInfo)
+{
+    const VkDescriptorSetLayoutBindingFlagsCreateInfo* bindingFlags = nullptr;
+    for(const VkBaseInStructure* next = static_cast<const VkBaseInStructure*>(createInfo.pNext); next != nullptr; next = next->pNext)
+    {
+        if(next->sType != VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO)
+            throw std::runtime_error("descriptor set layout with a pNext the layout cache can't compare.");
+        bindingFlags = reinterpret_cast<const VkDescriptorSetLayoutBindingFlagsCreateInfo*>(next);
+        //zero means no flags at all, anything else has to give one per binding (the flags are read by binding index).
+        if(bindingFlags->bindingCount != 0 && bindingFlags->bindingCount != createInfo.bindingCount)
+            throw std::runtime_error("descriptor set layout binding flags don't match its binding count.");
+    }
+
+    Key key;
+    key.flags = createInfo.flags;
+    key.bindings.reserve(createInfo.bindingCount);
+    for(uint32_t i = 0; i < createInfo.bindingCount; i++)
+    {
+        const VkDescriptorSetLayoutBinding& source = createInfo.pBindings[i];
+        Binding binding;
+        binding.binding = source.binding;
+        binding.type = source.descriptorType;
+        binding.count = source.descriptorCount;
+        binding.stages = source.stageFlags;
+        binding.flags = bindingFlags != nullptr && bindingFlags->bindingCount > 0 ? bindingFlags->pBindingFlags[i] : 0;
+        binding.firstImmutableSampler = NO_IMMUTABLE_SAMPLERS;
+        key.bindings.push_back(binding);
+    }
+
+    //sort by binding number so the order the bindings were listed in doesn't matter, samplers are gathered after
+    //sorting so equal layouts also end up with the same sampler list.
+    std::vector<uint32_t> order(createInfo.bindingCount);
+    for(uint32_t i = 0; i < createInfo.bindingCount; i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&key](uint32_t a, uint32_t b) { return key.bindings[a].binding < key.bindings[b].binding; });
+
+    std::vector<Binding> sorted;
+    sorted.reserve(order.size());
+    for(uint32_t index : order)
+    {
+        Binding binding = key.bindings[index];
+        const VkDescriptorSetLayoutBinding& source = createInfo.pBindings[index];
+        if(source.pImmutableSamplers != nullptr)
+        {
+            binding.firstImmutableSampler = static_cast<uint32_t>(key.immutableSamplers.size());
+            key.immutableSamplers.insert(key.immutableSamplers.end(), source.pImmutableSamplers, source.pImmutableSamplers + source.descriptorCount);
+        }
+        sorted.push_back(binding);
+    }
+    key.bindings.swap(sorted);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = layouts.find(key);
+    if(found != layouts.end())
+        return found->second;
+
+    VkDescriptorSetLayout layout;
+    if(vkd.vkCreateDescriptorSetLayout(device, &createInfo, hostAllocator.callbacks(), &layout) != VK_SUCCESS)
+        throw std::runtime_error("failed to create a descriptor set layout.");
+    layouts.emplace(std::move(key), layout);
+    return layout;
+}
+
+size_t DescriptorLayoutCache::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return layouts.size();
+}
+
+void DescriptorAllocator::init(VkDevice device, uint32_t setsPerPool)
+{
+    this->device = device;
+    nextPoolSets = setsPerPool;
+}
+
+void DescriptorAllocator::destroy()
+{
+    for(VkDescriptorPool pool : usedPools)
+        vkd.vkDestroyDescriptorPool(device, pool, hostAllocator.callbacks());
+    for(VkDescriptorPool pool : freePools)
+        vkd.vkDestroyDescriptorPool(device, pool, hostAllocator.callbacks());
+    usedPools.clear();
+    freePools.clear();
+    currentPool = VK_NULL_HANDLE;
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout, const void* pNext)
+{
+    if(currentPool == VK_NULL_HANDLE)
+        currentPool = grabPool();
+
+    VkDescriptorSetAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocateInfo.pNext = pNext;
+    allocateInfo.descriptorPool = currentPool;
+    allocateInfo.descriptorSetCount = 1;
+    allocateInfo.pSetLayouts = &layout;
+
+    VkDescriptorSet set;
+    VkResult result = vkd.vkAllocateDescriptorSets(device, &allocateInfo, &set);
+    if(result == VK_SUCCESS)
+        return set;
+
+    //a full pool isn't an error, leave it for the rest of the frame and try again from a fresh one.
+    if(result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL)
+        throw std::runtime_error("failed to allocate a descriptor set.");
+
+    currentPool = grabPool();
+    allocateInfo.descriptorPool = currentPool;
+    if(vkd.vkAllocateDescriptorSets(device, &allocateInfo, &set) != VK_SUCCESS)
+        throw std::runtime_error("descriptor set doesn't fit into an empty pool.");
+    return set;
+}
+
+void DescriptorAllocator::reset()
+{
+    for(VkDescriptorPool pool : usedPools)
+    {
+        vkd.vkResetDescriptorPool(device, pool, 0);
+        freePools.push_back(pool);
+    }
+    usedPools.clear();
+    currentPool = VK_NULL_HANDLE;
+}
+
+VkDescriptorPool DescriptorAllocator::grabPool()
+{
+    VkDescriptorPool pool;
+    if(!freePools.empty())
+    {
+        pool = freePools.back();
+        freePools.pop_back();
+    }
+    else
+    {
+        uint32_t sets = nextPoolSets;
+        nextPoolSets = std::min(nextPoolSets * 2, MAX_SETS_PER_POOL);
+
+        VkDescriptorPoolSize sizes[POOL_RATIO_COUNT];
+        for(size_t i = 0; i < POOL_RATIO_COUNT; i++)
+        {
+            sizes[i].type = poolRatios[i].type;
+            sizes[i].descriptorCount = std::max(1u, static_cast<uint32_t>(poolRatios[i].perSet * sets));
+        }
+
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.maxSets = sets;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(POOL_RATIO_COUNT);
+        poolInfo.pPoolSizes = sizes;
+
+        if(vkd.vkCreateDescriptorPool(device, &poolInfo, hostAllocator.callbacks(), &pool) != VK_SUCCESS)
+            throw std::runtime_error("failed to create a descriptor pool.");
+
+        //keep both lists able to hold every pool, so moving pools between them never allocates.
+        usedPools.reserve(poolCount() + 1);
+        freePools.reserve(poolCount() + 1);
+    }
+
+    usedPools.push_back(pool);
+    return pool;
+}
@@ -0,0 +1,91 @@
+#ifndef VECL_DESCRIPTORALLOCATOR_H
+#define VECL_DESCRIPTORALLOCATOR_H
+
+#include "VulkanDispatch.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+//creates every descriptor set layout once and hands out the same VkDescriptorSetLayout for equal create infos.
+//layouts are compared by value (flags, bindings in any order, binding flags and immutable samplers), so code that
+//builds the same layout in several places ends up sharing it. safe to use from any thread.
+class DescriptorLayoutCache
+{
+public:
+    void init(VkDevice device);
+    //destroys every layout, nothing may use them anymore.
+    void destroy();
+
+    //understands VkDescriptorSetLayoutBindingFlagsCreateInfo in pNext, anything else there throws.
+    VkDescriptorSetLayout get(const VkDescriptorSetLayoutCreateInfo& createInfo);
+
+    size_t size() const;
+
+private:
+    struct Binding
+    {
+        uint32_t binding;
+        VkDescriptorType type;
+        uint32_t count;
+        VkShaderStageFlags stages;
+        VkDescriptorBindingFlags flags;
+        //offset into Key::immutableSamplers, or UINT32_MAX if the binding has none.
+        uint32_t firstImmutableSampler;
+
+        bool operator==(const Binding& other) const;
+    };
+
+    struct Key
+    {
+        VkDescriptorSetLayoutCreateFlags flags;
+        std::vector<Binding> bindings;
+        std::vector<VkSampler> immutableSamplers;
+
+        bool operator==(const Key& other) const;
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    mutable std::mutex mutex;
+    std::unordered_map<Key, VkDescriptorSetLayout, KeyHash> layouts;
+};
+
+//hands out descriptor sets that only live for one frame. sets come from a list of pools that grows when a pool runs
+//out, and instead of freeing sets one by one the whole list is reset at once when the frame comes around again, so
+//neither allocating nor "freeing" ever goes back to the driver per set.
+//one per frame in flight and recording thread, it is not thread safe.
+class DescriptorAllocator
+{
+public:
+    //"setsPerPool" is the size of the first pool, every new pool after that is twice as big (up to a limit).
+    void init(VkDevice device, uint32_t setsPerPool = 64);
+    void destroy();
+
+    //allocates a set with "layout" from the current pool, moving on to another pool if this one is full.
+    //"pNext" is passed on to vkAllocateDescriptorSets (variable descriptor counts).
+    VkDescriptorSet allocate(VkDescriptorSetLayout layout, const void* pNext = nullptr);
+
+    //returns every set handed out since the last reset, only once the GPU is done with the frame that used them.
+    void reset();
+
+    //pools owned right now, this should stop growing after the first few frames.
+    size_t poolCount() const { return usedPools.size() + freePools.size(); }
+
+private:
+    VkDescriptorPool grabPool();
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkDescriptorPool currentPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorPool> usedPools;
+    std::vector<VkDescriptorPool> freePools;
+    uint32_t nextPoolSets = 64;
+};
+
+#endif //VECL_DESCRIPTORALLOCATOR_H
@@ -0,0 +1,193 @@
+#include "DescriptorTemplate.h"
+
+#include "DeviceFeatures.h"
+#include "HostAllocator.h"
+
+#include <stdexcept>
+
+namespace
+{
+    //the smallest maxPushDescriptors the extension allows, bigger sets go through the frame's pools.
+    const uint32_t MIN_MAX_PUSH_DESCRIPTORS = 32;
+    const uint32_t MAX_FALLBACK_WRITES = 32;
+
+    bool isImage(VkDescriptorType type)
+    {
+        return type == VK_DESCRIPTOR_TYPE_SAMPLER || type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER ||
+               type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE || type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE ||
+               type == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+    }
+
+    bool isTexelBuffer(VkDescriptorType type)
+    {
+        return type == VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER || type == VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER;
+    }
+
+    bool isDynamic(VkDescriptorType type)
+    {
+        return type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC || type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    }
+
+    size_t infoSize(VkDescriptorType type)
+    {
+        if(isImage(type))
+            return sizeof(VkDescriptorImageInfo);
+        if(isTexelBuffer(type))
+            return sizeof(VkBufferView);
+        return sizeof(VkDescriptorBufferInfo);
+    }
+}
+
+VkDescriptorSetLayout DescriptorTemplate::init(VkDevice device, DescriptorLayoutCache& layouts, const DescriptorTemplateEntry* entries, uint32_t entryCount)
+{
+    if(entryCount > MAX_ENTRIES)
+        throw std::runtime_error("too many bindings for a descriptor template.");
+
+    this->device = device;
+    this->entryCount = entryCount;
+
+    VkDescriptorSetLayoutBinding bindings[MAX_ENTRIES] = {};
+    uint32_t descriptorCount = 0;
+    bool dynamic = false;
+    for(uint32_t i = 0; i < entryCount; i++)
+    {
+        if(entries[i].stride < infoSize(entries[i].type))
+            throw std::runtime_error("descriptor template entry with a stride smaller than its descriptor.");
+
+        this->entries[i] = entries[i];
+        bindings[i].binding = entries[i].binding;
+        bindings[i].descriptorType = entries[i].type;
+        bindings[i].descriptorCount = entries[i].count;
+        bindings[i].stageFlags = entries[i].stages;
+        descriptorCount += entries[i].count;
+        dynamic = dynamic || isDynamic(entries[i].type);
+    }
+
+    //push descriptor layouts can't have dynamic buffers, the offsets are simply part of the pushed data instead.
+    push = capabilities.pushDescriptors && capabilities.updateTemplates && !dynamic && descriptorCount <= MIN_MAX_PUSH_DESCRIPTORS;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.flags = push ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR : 0;
+    layoutInfo.bindingCount = entryCount;
+    layoutInfo.pBindings = bindings;
+    setLayout = layouts.get(layoutInfo);
+    return setLayout;
+}
+
+void DescriptorTemplate::setPipelineLayout(VkPipelineLayout pipelineLayout, uint32_t set, VkPipelineBindPoint bindPoint)
+{
+    this->pipelineLayout = pipelineLayout;
+    this->set = set;
+    this->bindPoint = bindPoint;
+    if(!capabilities.updateTemplates)
+        return;
+
+    VkDescriptorUpdateTemplateEntry templateEntries[MAX_ENTRIES];
+    for(uint32_t i = 0; i < entryCount; i++)
+    {
+        templateEntries[i].dstBinding = entries[i].binding;
+        templateEntries[i].dstArrayElement = 0;
+        templateEntries[i].descriptorCount = entries[i].count;
+        templateEntries[i].descriptorType = entries[i].type;
+        templateEntries[i].offset = entries[i].offset;
+        templateEntries[i].stride = entries[i].stride;
+    }
+
+    VkDescriptorUpdateTemplateCreateInfo templateInfo = {};
+    templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+    templateInfo.descriptorUpdateEntryCount = entryCount;
+    templateInfo.pDescriptorUpdateEntries = templateEntries;
+    if(push)
+    {
+        templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_PUSH_DESCRIPTORS_KHR;
+        templateInfo.pipelineBindPoint = bindPoint;
+        templateInfo.pipelineLayout = pipelineLayout;
+        templateInfo.set = set;
+    }
+    else
+    {
+        templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+        templateInfo.descriptorSetLayout = setLayout;
+    }
+
+    if(vkd.vkCreateDescriptorUpdateTemplate(device, &templateInfo, hostAllocator.callbacks(), &updateTemplate) != VK_SUCCESS)
+        throw std::runtime_error("failed to create a descriptor update template.");
+}
+
+void DescriptorTemplate::destroy()
+{
+    //the set layout belongs to the layout cache.
+    if(updateTemplate != VK_NULL_HANDLE)
+        vkd.vkDestroyDescriptorUpdateTemplate(device, updateTemplate, hostAllocator.callbacks());
+    updateTemplate = VK_NULL_HANDLE;
+    setLayout = VK_NULL_HANDLE;
+    pipelineLayout = VK_NULL_HANDLE;
+}
+
+void DescriptorTemplate::bind(VkCommandBuffer commandBuffer, DescriptorAllocator& frameDescriptors, const void* data) const
+{
+    if(push)
+    {
+        vkd.vkCmdPushDescriptorSetWithTemplateKHR(commandBuffer, updateTemplate, pipelineLayout, set, data);
+        return;
+    }
+
+    VkDescriptorSet descriptorSet = frameDescriptors.allocate(setLayout);
+    update(descriptorSet, data);
+    vkd.vkCmdBindDescriptorSets(commandBuffer, bindPoint, pipelineLayout, set, 1, &descriptorSet, 0, nullptr);
+}
+
+void DescriptorTemplate::update(VkDescriptorSet descriptorSet, const void* data) const
+{
+    if(push)
+        throw std::runtime_error("pushed descriptor template used to write a descriptor set.");
+
+    if(updateTemplate != VK_NULL_HANDLE)
+        vkd.vkUpdateDescriptorSetWithTemplate(device, descriptorSet, updateTemplate, data);
+    else
+        writeWithoutTemplate(descriptorSet, data);
+}
+
+void DescriptorTemplate::writeWithoutTemplate(VkDescriptorSet descriptorSet, const void* data) const
+{
+    //the writes point straight into "data", an entry is one write when its elements are packed and one per element otherwise.
+    VkWriteDescriptorSet writes[MAX_FALLBACK_WRITES];
+    uint32_t writeCount = 0;
+    const char* bytes = static_cast<const char*>(data);
+
+    for(uint32_t i = 0; i < entryCount; i++)
+    {
+        const DescriptorTemplateEntry& entry = entries[i];
+        bool packed = entry.stride == infoSize(entry.type);
+        uint32_t perWrite = packed ? entry.count : 1;
+
+        for(uint32_t element = 0; element < entry.count; element += perWrite)
+        {
+            if(writeCount == MAX_FALLBACK_WRITES)
+            {
+                vkd.vkUpdateDescriptorSets(device, writeCount, writes, 0, nullptr);
+                writeCount = 0;
+            }
+
+            const char* source = bytes + entry.offset + element * entry.stride;
+            VkWriteDescriptorSet& write = writes[writeCount++];
+            write = {};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = descriptorSet;
+            write.dstBinding = entry.binding;
+            write.dstArrayElement = element;
+            write.descriptorCount = perWrite;
+            write.descriptorType = entry.type;
+            if(isImage(entry.type))
+                write.pImageInfo = reinterpret_cast<const VkDescriptorImageInfo*>(source);
+            else if(isTexelBuffer(entry.type))
+                write.pTexelBufferView = reinterpret_cast<const VkBufferView*>(source);
+            else
+                write.pBufferInfo = reinterpret_cast<const VkDescriptorBufferInfo*>(source);
+        }
+    }
+
+    if(writeCount > 0)
+        vkd.vkUpdateDescriptorSets(device, writeCount, writes, 0, nullptr);
+}
@@ -0,0 +1,68 @@
+#ifndef VECL_DESCRIPTORTEMPLATE_H
+#define VECL_DESCRIPTORTEMPLATE_H
+
+#include "VulkanDispatch.h"
+#include "DescriptorAllocator.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+//one binding of a set and where its descriptors sit in the C++ struct that holds the set's contents. the struct
+//members are VkDescriptorImageInfo, VkDescriptorBufferInfo or VkBufferView (or arrays of them), matching "type".
+struct DescriptorTemplateEntry
+{
+    uint32_t binding;
+    VkDescriptorType type;
+    uint32_t count;
+    VkShaderStageFlags stages;
+    size_t offset;
+    size_t stride;
+};
+
+//an entry for a member of "Struct", for an array member the count and stride come from the array.
+#define VECL_DESCRIPTOR_ENTRY(Struct, member, binding, descriptorType, stages) \
+    DescriptorTemplateEntry{binding, descriptorType, \
+                            static_cast<uint32_t>(sizeof(Struct::member) / sizeof(std::remove_extent<decltype(Struct::member)>::type)), \
+                            stages, offsetof(Struct, member), sizeof(std::remove_extent<decltype(Struct::member)>::type)}
+
+//writes a whole per draw or per pass set from a packed struct in one call instead of building VkWriteDescriptorSet
+//arrays every time. with VK_KHR_push_descriptor the set is pushed straight into the command buffer, otherwise it is
+//allocated from the frame's DescriptorAllocator, written with vkUpdateDescriptorSetWithTemplate and bound.
+//on a 1.0 device the same entries are turned into plain writes.
+class DescriptorTemplate
+{
+public:
+    static const uint32_t MAX_ENTRIES = 16;
+
+    //gets the set layout for "entries" from "layouts" (a push descriptor layout when the set is pushed), the pipeline
+    //layout has to be built with it before setPipelineLayout().
+    VkDescriptorSetLayout init(VkDevice device, DescriptorLayoutCache& layouts, const DescriptorTemplateEntry* entries, uint32_t entryCount);
+    //creates the update template, "set" is the set number the layout has in "pipelineLayout".
+    void setPipelineLayout(VkPipelineLayout pipelineLayout, uint32_t set, VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS);
+    void destroy();
+
+    //makes "data" the contents of the set for the commands recorded after it.
+    void bind(VkCommandBuffer commandBuffer, DescriptorAllocator& frameDescriptors, const void* data) const;
+    //writes "data" into a set allocated with layout(), only for sets that aren't pushed.
+    void update(VkDescriptorSet descriptorSet, const void* data) const;
+
+    VkDescriptorSetLayout layout() const { return setLayout; }
+    bool pushes() const { return push; }
+
+private:
+    void writeWithoutTemplate(VkDescriptorSet descriptorSet, const void* data) const;
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    uint32_t set = 0;
+    VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    VkDescriptorUpdateTemplate updateTemplate = VK_NULL_HANDLE;
+    bool push = false;
+
+    DescriptorTemplateEntry entries[MAX_ENTRIES] = {};
+    uint32_t entryCount = 0;
+};
+
+#endif //VECL_DESCRIPTORTEMPLATE_H
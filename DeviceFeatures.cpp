@@ -0,0 +1,276 @@
+#include "DeviceFeatures.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+
+DeviceCapabilities capabilities;
+
+namespace
+{
+    //the newest version we know how to use, asking for more than this only risks behaviour changes.
+    const uint32_t MAX_API_VERSION = VK_API_VERSION_1_3;
+
+    bool hasExtension(const std::vector<VkExtensionProperties>& available, const char* name)
+    {
+        for(const VkExtensionProperties& extension : available)
+        {
+            if(std::strcmp(extension.extensionName, name) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    const char* yesNo(bool value)
+    {
+        return value ? "yes" : "no";
+    }
+}
+
+void DeviceNegotiator::resetChain()
+{
+    features2 = {};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    timelineFeatures = {};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    indexingFeatures = {};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    addressFeatures = {};
+    addressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
+    synchronization2Features = {};
+    synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES;
+    dynamicRenderingFeatures = {};
+    dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
+    dynamicStateFeatures = {};
+    dynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+    dynamicState2Features = {};
+    dynamicState2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT;
+    dynamicState3Features = {};
+    dynamicState3Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+    vertexInputFeatures = {};
+    vertexInputFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VERTEX_INPUT_DYNAMIC_STATE_FEATURES_EXT;
+    pipelineLibraryFeatures = {};
+    pipelineLibraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+}
+
+const DeviceCapabilities& DeviceNegotiator::negotiate(VkPhysicalDevice physicalDevice, uint32_t instanceApiVersion)
+{
+    capabilities = DeviceCapabilities();
+    extensions.clear();
+    resetChain();
+
+    VkPhysicalDeviceProperties properties;
+    vkd.vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    uint32_t apiVersion = std::min({instanceApiVersion, properties.apiVersion, MAX_API_VERSION});
+    capabilities.apiVersion = apiVersion;
+
+    //everything below needs vkGetPhysicalDeviceFeatures2, a 1.0 device gets the plain 1.0 paths.
+    useFeatures2 = apiVersion >= VK_API_VERSION_1_1 && vkd.vkGetPhysicalDeviceFeatures2 != nullptr;
+    if(!useFeatures2)
+        return capabilities;
+
+    uint32_t extensionCount = 0;
+    vkd.vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> available(extensionCount);
+    vkd.vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, available.data());
+
+    //a feature can only be asked about if core or one of the device's extensions knows the struct.
+    bool timelineKnown = apiVersion >= VK_API_VERSION_1_2 || hasExtension(available, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+    bool indexingKnown = apiVersion >= VK_API_VERSION_1_2 || hasExtension(available, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+    bool addressKnown = apiVersion >= VK_API_VERSION_1_2 || hasExtension(available, VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME);
+    bool synchronization2Known = apiVersion >= VK_API_VERSION_1_3 || hasExtension(available, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+    //the extension also needs depth stencil resolve and render pass 2, which are only core from 1.2 on.
+    bool dynamicRenderingKnown = apiVersion >= VK_API_VERSION_1_3 ||
+                                 (apiVersion >= VK_API_VERSION_1_2 && hasExtension(available, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME));
+    //the first two dynamic state extensions are core in 1.3 without a feature bit, they only need asking about before that.
+    bool dynamicStateKnown = apiVersion < VK_API_VERSION_1_3 && hasExtension(available, VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+    bool dynamicState2Known = apiVersion < VK_API_VERSION_1_3 && hasExtension(available, VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME);
+    bool dynamicState3Known = hasExtension(available, VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+    bool vertexInputKnown = hasExtension(available, VK_EXT_VERTEX_INPUT_DYNAMIC_STATE_EXTENSION_NAME);
+    bool pipelineLibraryKnown = hasExtension(available, VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+                                hasExtension(available, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+
+    void* query = nullptr;
+    if(timelineKnown)
+        link(query, timelineFeatures);
+    if(indexingKnown)
+        link(query, indexingFeatures);
+    if(addressKnown)
+        link(query, addressFeatures);
+    if(synchronization2Known)
+        link(query, synchronization2Features);
+    if(dynamicRenderingKnown)
+        link(query, dynamicRenderingFeatures);
+    if(dynamicStateKnown)
+        link(query, dynamicStateFeatures);
+    if(dynamicState2Known)
+        link(query, dynamicState2Features);
+    if(dynamicState3Known)
+        link(query, dynamicState3Features);
+    if(vertexInputKnown)
+        link(query, vertexInputFeatures);
+    if(pipelineLibraryKnown)
+        link(query, pipelineLibraryFeatures);
+    features2.pNext = query;
+
+    vkd.vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+    capabilities.memoryBudget = hasExtension(available, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    capabilities.updateTemplates = true;
+    capabilities.pushDescriptors = hasExtension(available, VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+    capabilities.timelineSemaphores = timelineKnown && timelineFeatures.timelineSemaphore;
+    capabilities.descriptorIndexing = indexingKnown && indexingFeatures.runtimeDescriptorArray && indexingFeatures.descriptorBindingPartiallyBound &&
+                                      indexingFeatures.descriptorBindingVariableDescriptorCount &&
+                                      indexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+                                      indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind &&
+                                      indexingFeatures.descriptorBindingUpdateUnusedWhilePending &&
+                                      indexingFeatures.shaderSampledImageArrayNonUniformIndexing &&
+                                      indexingFeatures.shaderStorageBufferArrayNonUniformIndexing;
+    capabilities.bufferDeviceAddress = addressKnown && addressFeatures.bufferDeviceAddress;
+    capabilities.synchronization2 = synchronization2Known && synchronization2Features.synchronization2;
+    capabilities.dynamicRendering = dynamicRenderingKnown && dynamicRenderingFeatures.dynamicRendering;
+    capabilities.extendedDynamicState = apiVersion >= VK_API_VERSION_1_3 || (dynamicStateKnown && dynamicStateFeatures.extendedDynamicState);
+    //the pipeline registry only makes state 2 and 3 dynamic on top of state 1, it doesn't track them separately.
+    capabilities.extendedDynamicState2 = capabilities.extendedDynamicState &&
+                                         (apiVersion >= VK_API_VERSION_1_3 || (dynamicState2Known && dynamicState2Features.extendedDynamicState2));
+    capabilities.extendedDynamicState3 = capabilities.extendedDynamicState2 && dynamicState3Known &&
+                                         dynamicState3Features.extendedDynamicState3PolygonMode &&
+                                         dynamicState3Features.extendedDynamicState3AlphaToCoverageEnable &&
+                                         dynamicState3Features.extendedDynamicState3ColorBlendEnable &&
+                                         dynamicState3Features.extendedDynamicState3ColorBlendEquation &&
+                                         dynamicState3Features.extendedDynamicState3ColorWriteMask;
+    capabilities.vertexInputDynamicState = vertexInputKnown && vertexInputFeatures.vertexInputDynamicState;
+    if(pipelineLibraryKnown && pipelineLibraryFeatures.graphicsPipelineLibrary)
+    {
+        //without fast linking a link costs about as much as a whole pipeline, the libraries wouldn't save anything.
+        VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT libraryProperties = {};
+        libraryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT;
+        VkPhysicalDeviceProperties2 properties2 = {};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &libraryProperties;
+        vkd.vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+        capabilities.graphicsPipelineLibrary = libraryProperties.graphicsPipelineLibraryFastLinking;
+    }
+
+    //the query filled in everything the device has, rebuild the chain with only the bits we actually use so the driver
+    //doesn't pay for features (robustness, capture replay, ...) nothing asks for.
+    VkPhysicalDeviceFeatures baseFeatures = {};
+    resetChain();
+    features2.features = baseFeatures;
+
+    void* enable = nullptr;
+    if(capabilities.timelineSemaphores)
+    {
+        timelineFeatures.timelineSemaphore = VK_TRUE;
+        link(enable, timelineFeatures);
+        if(apiVersion < VK_API_VERSION_1_2)
+            extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+    }
+    if(capabilities.descriptorIndexing)
+    {
+        indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+        indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+        indexingFeatures.descriptorBindingVariableDescriptorCount = VK_TRUE;
+        indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+        indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        indexingFeatures.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+        link(enable, indexingFeatures);
+        if(apiVersion < VK_API_VERSION_1_2)
+            extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+    }
+    if(capabilities.bufferDeviceAddress)
+    {
+        addressFeatures.bufferDeviceAddress = VK_TRUE;
+        link(enable, addressFeatures);
+        if(apiVersion < VK_API_VERSION_1_2)
+            extensions.push_back(VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME);
+    }
+    if(capabilities.synchronization2)
+    {
+        synchronization2Features.synchronization2 = VK_TRUE;
+        link(enable, synchronization2Features);
+        if(apiVersion < VK_API_VERSION_1_3)
+            extensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+    }
+    if(capabilities.dynamicRendering)
+    {
+        dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+        link(enable, dynamicRenderingFeatures);
+        if(apiVersion < VK_API_VERSION_1_3)
+            extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+    }
+    if(capabilities.extendedDynamicState && apiVersion < VK_API_VERSION_1_3)
+    {
+        dynamicStateFeatures.extendedDynamicState = VK_TRUE;
+        link(enable, dynamicStateFeatures);
+        extensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+    }
+    if(capabilities.extendedDynamicState2 && apiVersion < VK_API_VERSION_1_3)
+    {
+        dynamicState2Features.extendedDynamicState2 = VK_TRUE;
+        link(enable, dynamicState2Features);
+        extensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME);
+    }
+    if(capabilities.extendedDynamicState3)
+    {
+        dynamicState3Features.extendedDynamicState3PolygonMode = VK_TRUE;
+        dynamicState3Features.extendedDynamicState3AlphaToCoverageEnable = VK_TRUE;
+        dynamicState3Features.extendedDynamicState3ColorBlendEnable = VK_TRUE;
+        dynamicState3Features.extendedDynamicState3ColorBlendEquation = VK_TRUE;
+        dynamicState3Features.extendedDynamicState3ColorWriteMask = VK_TRUE;
+        link(enable, dynamicState3Features);
+        extensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+    }
+    if(capabilities.vertexInputDynamicState)
+    {
+        vertexInputFeatures.vertexInputDynamicState = VK_TRUE;
+        link(enable, vertexInputFeatures);
+        extensions.push_back(VK_EXT_VERTEX_INPUT_DYNAMIC_STATE_EXTENSION_NAME);
+    }
+    if(capabilities.graphicsPipelineLibrary)
+    {
+        pipelineLibraryFeatures.graphicsPipelineLibrary = VK_TRUE;
+        link(enable, pipelineLibraryFeatures);
+        extensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+        extensions.push_back(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+    }
+    features2.pNext = enable;
+
+    if(capabilities.memoryBudget)
+        extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if(capabilities.pushDescriptors)
+        extensions.push_back(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+
+    return capabilities;
+}
+
+void DeviceNegotiator::apply(VkDeviceCreateInfo& createInfo) const
+{
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    createInfo.ppEnabledExtensionNames = extensions.data();
+
+    //with VkPhysicalDeviceFeatures2 in the chain pEnabledFeatures has to be null, the base features ride along in it.
+    if(useFeatures2)
+    {
+        createInfo.pNext = &features2;
+        createInfo.pEnabledFeatures = nullptr;
+    }
+    else
+        createInfo.pEnabledFeatures = &features2.features;
+}
+
+void DeviceNegotiator::printReport(std::ostream& out) const
+{
+    out << "Device features (Vulkan " << VK_API_VERSION_MAJOR(capabilities.apiVersion) << "." << VK_API_VERSION_MINOR(capabilities.apiVersion)
+        << "): timeline semaphores " << yesNo(capabilities.timelineSemaphores) << ", descriptor indexing "
+        << yesNo(capabilities.descriptorIndexing) << ", buffer device address " << yesNo(capabilities.bufferDeviceAddress)
+        << ", synchronization2 " << yesNo(capabilities.synchronization2) << ", dynamic rendering "
+        << yesNo(capabilities.dynamicRendering) << ", memory budget " << yesNo(capabilities.memoryBudget)
+        << ", update templates " << yesNo(capabilities.updateTemplates) << ", push descriptors "
+        << yesNo(capabilities.pushDescriptors) << ", extended dynamic state " << yesNo(capabilities.extendedDynamicState) << "/"
+        << yesNo(capabilities.extendedDynamicState2) << "/" << yesNo(capabilities.extendedDynamicState3)
+        << ", dynamic vertex input " << yesNo(capabilities.vertexInputDynamicState) << ", pipeline libraries "
+        << yesNo(capabilities.graphicsPipelineLibrary) << std::endl;
+}
@@ -0,0 +1,83 @@
+#ifndef VECL_DEVICEFEATURES_H
+#define VECL_DEVICEFEATURES_H
+
+#include "VulkanDispatch.h"
+
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+//what the renderer may use on the device it runs on, every fast path checks its flag here and falls back without it.
+struct DeviceCapabilities
+{
+    //the version the instance and the device both speak (the lower of the two), capped at 1.3.
+    uint32_t apiVersion = VK_API_VERSION_1_0;
+    bool memoryBudget = false;
+    bool timelineSemaphores = false;
+    //descriptor indexing with everything a bindless table needs: runtime sized, partially bound, update after bind (also
+    //while frames using the set are in flight) and non uniform indexing of sampled images and storage buffers.
+    bool descriptorIndexing = false;
+    bool bufferDeviceAddress = false;
+    bool synchronization2 = false;
+    bool dynamicRendering = false;
+    //vkUpdateDescriptorSetWithTemplate, core from 1.1 on.
+    bool updateTemplates = false;
+    //VK_KHR_push_descriptor, small per draw sets go straight into the command buffer instead of a pool.
+    bool pushDescriptors = false;
+    //cull mode, front face, topology (within its point/line/triangle class) and the depth test set while recording.
+    bool extendedDynamicState = false;
+    //depth bias and primitive restart enables set while recording.
+    bool extendedDynamicState2 = false;
+    //polygon mode, alpha to coverage and the whole color blend state set while recording.
+    bool extendedDynamicState3 = false;
+    //vertex bindings and attributes set while recording, pipelines no longer depend on the vertex layout.
+    bool vertexInputDynamicState = false;
+    //VK_EXT_graphics_pipeline_library with fast linking, pipelines are linked from separately compiled parts.
+    bool graphicsPipelineLibrary = false;
+};
+
+//filled in by DeviceNegotiator::negotiate(), read by everything else.
+extern DeviceCapabilities capabilities;
+
+//works out which features and extensions to turn on for a device and builds the pNext chain that does it.
+//every feature comes from core when the API version has it and from its extension otherwise, so a 1.1 driver with
+//the right extensions gets the same paths as a 1.3 one.
+class DeviceNegotiator
+{
+public:
+    //asks the device what it supports (vkGetPhysicalDeviceFeatures2 over the whole chain) and decides what to enable.
+    const DeviceCapabilities& negotiate(VkPhysicalDevice physicalDevice, uint32_t instanceApiVersion);
+
+    //points "createInfo" at the features and extensions to enable, the negotiator has to outlive vkCreateDevice.
+    void apply(VkDeviceCreateInfo& createInfo) const;
+
+    void printReport(std::ostream& out) const;
+
+private:
+    //links "feature" in front of the chain that starts at "head".
+    template<typename T>
+    static void link(void*& head, T& feature)
+    {
+        feature.pNext = head;
+        head = &feature;
+    }
+
+    void resetChain();
+
+    VkPhysicalDeviceFeatures2 features2 = {};
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures = {};
+    VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures = {};
+    VkPhysicalDeviceBufferDeviceAddressFeatures addressFeatures = {};
+    VkPhysicalDeviceSynchronization2Features synchronization2Features = {};
+    VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeatures = {};
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT dynamicStateFeatures = {};
+    VkPhysicalDeviceExtendedDynamicState2FeaturesEXT dynamicState2Features = {};
+    VkPhysicalDeviceExtendedDynamicState3FeaturesEXT dynamicState3Features = {};
+    VkPhysicalDeviceVertexInputDynamicStateFeaturesEXT vertexInputFeatures = {};
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipelineLibraryFeatures = {};
+
+    std::vector<const char*> extensions;
+    bool useFeatures2 = false;
+};
+
+#endif //VECL_DEVICEFEATURES_H
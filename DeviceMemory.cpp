@@ -0,0 +1,227 @@
+#include "DeviceMemory.h"
+
+#include "HostAllocator.h"
+
+#include <algorithm>
+#include <ostream>
+
+DeviceMemoryManager deviceMemory;
+
+namespace
+{
+    const char* const categoryNames[MEMORY_CATEGORY_COUNT] = {"textures", "buffers", "render targets", "staging", "other"};
+
+    //without VK_EXT_memory_budget we assume we can have this much of a heap, the rest is left for the OS and other apps.
+    const VkDeviceSize FALLBACK_BUDGET_PERCENT = 80;
+
+    double toMegabytes(VkDeviceSize bytes)
+    {
+        return static_cast<double>(bytes) / (1024.0 * 1024.0);
+    }
+}
+
+void DeviceMemoryManager::init(VkPhysicalDevice physicalDevice, VkDevice device, bool budgetExtensionEnabled)
+{
+    this->physicalDevice = physicalDevice;
+    this->device = device;
+    budgetExtension = budgetExtensionEnabled && vkd.vkGetPhysicalDeviceMemoryProperties2 != nullptr;
+
+    vkd.vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    for(uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+    {
+        heaps[i].size = memoryProperties.memoryHeaps[i].size;
+        heaps[i].deviceLocal = (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+    }
+
+    updateBudget();
+}
+
+VkResult DeviceMemoryManager::allocate(const VkMemoryAllocateInfo& allocateInfo, MemoryCategory category, VkDeviceMemory* memory)
+{
+    VkResult result = vkd.vkAllocateMemory(device, &allocateInfo, hostAllocator.callbacks(), memory);
+    if(result != VK_SUCCESS)
+        return result;
+
+    uint32_t heapIndex = memoryProperties.memoryTypes[allocateInfo.memoryTypeIndex].heapIndex;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    allocations[*memory] = {allocateInfo.allocationSize, heapIndex, category};
+    heaps[heapIndex].ownBytes += allocateInfo.allocationSize;
+    categoryTotals[category] += allocateInfo.allocationSize;
+    if(!budgetExtension)
+        heaps[heapIndex].usage = heaps[heapIndex].ownBytes;
+
+    return VK_SUCCESS;
+}
+
+void DeviceMemoryManager::free(VkDeviceMemory memory)
+{
+    if(memory == VK_NULL_HANDLE)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = allocations.find(memory);
+        if(found != allocations.end())
+        {
+            const Allocation& allocation = found->second;
+            HeapBudget& heap = heaps[allocation.heapIndex];
+            heap.ownBytes -= allocation.size;
+            //we can't tell which frees belong to evicted resources, any free on the heap pays the pending amount off.
+            heap.evicting -= std::min(heap.evicting, allocation.size);
+            categoryTotals[allocation.category] -= allocation.size;
+            if(!budgetExtension)
+                heap.usage = heap.ownBytes;
+            allocations.erase(found);
+        }
+    }
+
+    vkd.vkFreeMemory(device, memory, hostAllocator.callbacks());
+}
+
+void DeviceMemoryManager::updateBudget()
+{
+    if(budgetExtension)
+    {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+        budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+        VkPhysicalDeviceMemoryProperties2 properties2 = {};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        properties2.pNext = &budgetProperties;
+
+        vkd.vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &properties2);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for(uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+        {
+            heaps[i].budget = budgetProperties.heapBudget[i];
+            heaps[i].usage = budgetProperties.heapUsage[i];
+        }
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for(uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+        {
+            heaps[i].budget = heaps[i].size / 100 * FALLBACK_BUDGET_PERCENT;
+            heaps[i].usage = heaps[i].ownBytes;
+        }
+    }
+}
+
+uint64_t DeviceMemoryManager::registerEvictable(uint32_t heapIndex, VkDeviceSize size, int priority, EvictFunction evict, void* userData)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t id = nextEvictableId++;
+    evictables.push_back({id, heapIndex, size, priority, evict, userData});
+    return id;
+}
+
+void DeviceMemoryManager::unregisterEvictable(uint64_t id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    evictables.erase(std::remove_if(evictables.begin(), evictables.end(), [id](const Evictable& e) { return e.id == id; }), evictables.end());
+}
+
+VkDeviceSize DeviceMemoryManager::evictUnderPressure(float threshold)
+{
+    VkDeviceSize evicted = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        //how many bytes each heap has to lose to get back under the threshold.
+        VkDeviceSize excess[VK_MAX_MEMORY_HEAPS] = {};
+        bool anyExcess = false;
+        for(uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+        {
+            VkDeviceSize limit = static_cast<VkDeviceSize>(static_cast<double>(heaps[i].budget) * threshold);
+            VkDeviceSize usage = heaps[i].usage - std::min(heaps[i].usage, heaps[i].evicting);
+            if(heaps[i].budget > 0 && usage > limit)
+            {
+                excess[i] = usage - limit;
+                anyExcess = true;
+            }
+        }
+        if(!anyExcess || evictables.empty())
+            return 0;
+
+        //lowest priority first, the oldest registration first among equals.
+        std::sort(evictables.begin(), evictables.end(), [](const Evictable& a, const Evictable& b)
+        {
+            return a.priority != b.priority ? a.priority < b.priority : a.id < b.id;
+        });
+
+        victims.clear();
+        for(Evictable& candidate : evictables)
+        {
+            if(excess[candidate.heapIndex] == 0)
+                continue;
+
+            victims.push_back(candidate);
+            excess[candidate.heapIndex] -= std::min(excess[candidate.heapIndex], candidate.size);
+            //the memory is only really freed a few frames from now, count it as gone already so the next frames don't
+            //evict even more for the same shortfall.
+            heaps[candidate.heapIndex].evicting += candidate.size;
+            evicted += candidate.size;
+            candidate.evict = nullptr;
+        }
+
+        evictables.erase(std::remove_if(evictables.begin(), evictables.end(), [](const Evictable& e) { return e.evict == nullptr; }), evictables.end());
+    }
+
+    //outside the lock, evicting frees memory and may register other resources.
+    for(const Evictable& victim : victims)
+        victim.evict(victim.userData);
+
+    return evicted;
+}
+
+int DeviceMemoryManager::findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags flags) const
+{
+    for(uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+    {
+        if((typeBits & (1u << i)) && (memoryProperties.memoryTypes[i].propertyFlags & flags) == flags)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+HeapBudget DeviceMemoryManager::heapBudget(uint32_t heapIndex) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return heaps[heapIndex];
+}
+
+VkDeviceSize DeviceMemoryManager::categoryBytes(MemoryCategory category) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return categoryTotals[category];
+}
+
+void DeviceMemoryManager::printBudget(std::ostream& out, uint64_t frameNumber) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    out << "frame " << frameNumber << " memory:";
+    for(uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+        out << " heap " << i << " " << toMegabytes(heaps[i].usage) << "/" << toMegabytes(heaps[i].budget) << " MiB,";
+    for(int i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+        out << " " << categoryNames[i] << " " << toMegabytes(categoryTotals[i]) << " MiB" << (i + 1 < MEMORY_CATEGORY_COUNT ? "," : "");
+    out << std::endl;
+}
+
+void DeviceMemoryManager::printReport(std::ostream& out) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    out << "Device memory (" << (budgetExtension ? "VK_EXT_memory_budget" : "estimated budget") << ")" << std::endl;
+    for(uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+    {
+        const HeapBudget& heap = heaps[i];
+        out << "  heap " << i << (heap.deviceLocal ? " (device local)" : "") << ": " << toMegabytes(heap.usage) << " MiB used of "
+            << toMegabytes(heap.budget) << " MiB budget, " << toMegabytes(heap.ownBytes) << " MiB ours" << std::endl;
+    }
+    for(int i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+        out << "  " << categoryNames[i] << ": " << toMegabytes(categoryTotals[i]) << " MiB" << std::endl;
+}
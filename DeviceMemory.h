@@ -0,0 +1,112 @@
+#ifndef VECL_DEVICEMEMORY_H
+#define VECL_DEVICEMEMORY_H
+
+#include "VulkanDispatch.h"
+
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+//what a block of device memory is used for, every allocation is booked under one of these.
+enum MemoryCategory
+{
+    MEMORY_CATEGORY_TEXTURE = 0,
+    MEMORY_CATEGORY_BUFFER,
+    MEMORY_CATEGORY_RENDER_TARGET,
+    MEMORY_CATEGORY_STAGING,
+    MEMORY_CATEGORY_OTHER,
+    MEMORY_CATEGORY_COUNT
+};
+
+//budget and usage of one memory heap, straight from VK_EXT_memory_budget when the device has it.
+//without the extension the budget is a fixed share of the heap size and the usage is only what we allocated ourselves.
+struct HeapBudget
+{
+    VkDeviceSize size = 0;
+    VkDeviceSize budget = 0;
+    VkDeviceSize usage = 0;
+    //how much of "usage" came from allocate() below.
+    VkDeviceSize ownBytes = 0;
+    //evicted but not freed yet (the deletion queue waits for the GPU first), still part of "usage" until then.
+    VkDeviceSize evicting = 0;
+    bool deviceLocal = false;
+};
+
+//called to drop a resource when memory runs low, it should retire the resource (deletion queue) and free its memory.
+typedef void (*EvictFunction)(void* userData);
+
+//wraps vkAllocateMemory/vkFreeMemory to keep per heap and per category accounting, keeps the heap budgets up to date
+//and evicts low priority streamed resources when a heap gets close to its budget.
+class DeviceMemoryManager
+{
+public:
+    void init(VkPhysicalDevice physicalDevice, VkDevice device, bool budgetExtensionEnabled);
+
+    VkResult allocate(const VkMemoryAllocateInfo& allocateInfo, MemoryCategory category, VkDeviceMemory* memory);
+    //frees right away, the GPU must be done with it (use the deletion queue otherwise, it ends up here).
+    void free(VkDeviceMemory memory);
+
+    //re-reads the heap budgets, cheap enough to call every frame.
+    void updateBudget();
+
+    //registers something that can be thrown away and streamed back in later, lower priorities go first.
+    //returns an id for unregisterEvictable(), which the owner calls when it frees the resource on its own.
+    uint64_t registerEvictable(uint32_t heapIndex, VkDeviceSize size, int priority, EvictFunction evict, void* userData);
+    void unregisterEvictable(uint64_t id);
+
+    //evicts resources from every heap whose usage is above "threshold" of its budget until it's back under it.
+    //returns how many bytes were evicted.
+    VkDeviceSize evictUnderPressure(float threshold = 0.9f);
+
+    uint32_t heapCount() const { return memoryProperties.memoryHeapCount; }
+    //copies, the numbers keep changing on other threads.
+    HeapBudget heapBudget(uint32_t heapIndex) const;
+    VkDeviceSize categoryBytes(MemoryCategory category) const;
+    const VkPhysicalDeviceMemoryProperties& properties() const { return memoryProperties; }
+
+    //returns the first memory type allowed by "typeBits" with all of "flags", or -1.
+    int findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags flags) const;
+
+    void printReport(std::ostream& out) const;
+    //one line with the usage and budget of every heap and the bytes of every category, for printing while running.
+    void printBudget(std::ostream& out, uint64_t frameNumber) const;
+
+private:
+    struct Allocation
+    {
+        VkDeviceSize size;
+        uint32_t heapIndex;
+        MemoryCategory category;
+    };
+
+    struct Evictable
+    {
+        uint64_t id;
+        uint32_t heapIndex;
+        VkDeviceSize size;
+        int priority;
+        EvictFunction evict;
+        void* userData;
+    };
+
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+    bool budgetExtension = false;
+    VkPhysicalDeviceMemoryProperties memoryProperties = {};
+
+    mutable std::mutex mutex;
+    std::unordered_map<VkDeviceMemory, Allocation> allocations;
+    HeapBudget heaps[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize categoryTotals[MEMORY_CATEGORY_COUNT] = {};
+
+    std::vector<Evictable> evictables;
+    //kept between calls so evicting doesn't allocate.
+    std::vector<Evictable> victims;
+    uint64_t nextEvictableId = 1;
+};
+
+extern DeviceMemoryManager deviceMemory;
+
+#endif //VECL_DEVICEMEMORY_H
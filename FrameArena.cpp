@@ -0,0 +1,81 @@
+#include "FrameArena.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+LinearArena::LinearArena(size_t initialCapacity)
+{
+    blocks.reserve(8);
+    addBlock(initialCapacity);
+}
+
+LinearArena::~LinearArena()
+{
+    for(const Block& block : blocks)
+        std::free(block.data);
+}
+
+void LinearArena::addBlock(size_t minimumSize)
+{
+    //double the size each time so a frame that keeps overflowing only spills a handful of times.
+    size_t size = blocks.empty() ? minimumSize : blocks.back().size * 2;
+    if(size < minimumSize)
+        size = minimumSize;
+
+    char* data = static_cast<char*>(std::malloc(size));
+    if(data == nullptr)
+        throw std::bad_alloc();
+
+    blocks.push_back({data, size});
+    heapAllocationCount++;
+}
+
+void* LinearArena::allocate(size_t size, size_t alignment)
+{
+    for(;;)
+    {
+        Block& block = blocks[currentBlock];
+        uintptr_t base = reinterpret_cast<uintptr_t>(block.data);
+        uintptr_t aligned = (base + offset + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+        size_t end = (aligned - base) + size;
+
+        if(end <= block.size)
+        {
+            usedBytes += end - offset;
+            offset = end;
+            return reinterpret_cast<void*>(aligned);
+        }
+
+        //this block is full, move on to the next one (and make it if it doesn't exist yet).
+        if(currentBlock + 1 == blocks.size())
+            addBlock(size + alignment);
+        currentBlock++;
+        offset = 0;
+    }
+}
+
+void LinearArena::reset()
+{
+    if(blocks.size() > 1)
+    {
+        //the last frame didn't fit, replace everything with one block that holds all of it.
+        size_t total = capacity();
+        for(const Block& block : blocks)
+            std::free(block.data);
+        blocks.clear();
+        addBlock(total);
+    }
+
+    currentBlock = 0;
+    offset = 0;
+    usedBytes = 0;
+}
+
+size_t LinearArena::capacity() const
+{
+    size_t total = 0;
+    for(const Block& block : blocks)
+        total += block.size;
+    return total;
+}
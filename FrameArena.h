@@ -0,0 +1,85 @@
+#ifndef VECL_FRAMEARENA_H
+#define VECL_FRAMEARENA_H
+
+#include <cstddef>
+#include <vector>
+
+//a bump allocator for memory that only has to live for one frame.
+//allocating is a pointer increment and nothing is ever freed on its own, the whole arena is rewound with reset()
+//once the GPU has finished with the frame that used it (its fence signaled).
+//not thread safe, every recording thread should get its own arena.
+class LinearArena
+{
+public:
+    explicit LinearArena(size_t initialCapacity = 64 * 1024);
+    ~LinearArena();
+
+    LinearArena(const LinearArena&) = delete;
+    LinearArena& operator=(const LinearArena&) = delete;
+
+    //returns memory aligned to "alignment" (must be a power of two), never returns nullptr.
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    //rewinds the arena. if the frame spilled into extra blocks they get merged into one block that is big enough
+    //for the whole frame, so after a few frames of warm up the arena stops touching the heap completely.
+    void reset();
+
+    //bytes handed out since the last reset.
+    size_t used() const { return usedBytes; }
+    //bytes the arena owns right now.
+    size_t capacity() const;
+    //how many times the arena had to go to the heap since it was created, should stop growing in steady state.
+    size_t heapAllocations() const { return heapAllocationCount; }
+
+private:
+    struct Block
+    {
+        char* data;
+        size_t size;
+    };
+
+    void addBlock(size_t minimumSize);
+
+    std::vector<Block> blocks;
+    size_t currentBlock = 0;
+    size_t offset = 0;
+    size_t usedBytes = 0;
+    size_t heapAllocationCount = 0;
+};
+
+//std compatible allocator that takes its memory from a LinearArena, deallocate does nothing.
+//containers using it must not outlive the arena's next reset().
+template<typename T>
+class ArenaAllocator
+{
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(LinearArena& arena) noexcept : arena(&arena) {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept : arena(other.arena) {}
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, size_t) noexcept {}
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const noexcept { return arena == other.arena; }
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const noexcept { return arena != other.arena; }
+
+private:
+    template<typename U> friend class ArenaAllocator;
+    LinearArena* arena;
+};
+
+//vector for per frame scratch lists (draw lists, barriers, descriptor writes...), reserve() up front where the size is known
+//because the old storage of a growing vector is only reclaimed at the next reset.
+template<typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T>>;
+
+#endif //VECL_FRAMEARENA_H
@@ -0,0 +1,96 @@
+#include "FrameCommandPools.h"
+
+#include "HostAllocator.h"
+
+#include <ostream>
+#include <stdexcept>
+
+namespace
+{
+    //buffers are allocated this many at a time, so a thread's first frames don't allocate for every buffer.
+    const uint32_t ALLOCATION_BATCH = 4;
+}
+
+void FrameCommandPools::init(VkDevice device, uint32_t queueFamily, uint32_t threads)
+{
+    this->device = device;
+    threadPools = std::vector<ThreadPool>(threads);
+
+    //transient: the buffers live for one frame, which lets the driver pick a cheaper allocation strategy. there is no
+    //RESET_COMMAND_BUFFER_BIT, the buffers are only ever reset all together with their pool.
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = queueFamily;
+    for(ThreadPool& threadPool : threadPools)
+    {
+        if(vkd.vkCreateCommandPool(device, &poolInfo, hostAllocator.callbacks(), &threadPool.pool) != VK_SUCCESS)
+            throw std::runtime_error("failed to create a frame command pool.");
+    }
+}
+
+void FrameCommandPools::destroy()
+{
+    //the command buffers go away with their pools.
+    for(ThreadPool& threadPool : threadPools)
+    {
+        if(threadPool.pool != VK_NULL_HANDLE)
+            vkd.vkDestroyCommandPool(device, threadPool.pool, hostAllocator.callbacks());
+    }
+    threadPools.clear();
+}
+
+void FrameCommandPools::reset()
+{
+    for(ThreadPool& threadPool : threadPools)
+    {
+        //a pool nothing was taken from since the last reset has nothing to reset.
+        if(threadPool.used[0] == 0 && threadPool.used[1] == 0)
+            continue;
+        //without RELEASE_RESOURCES the pool keeps its memory for the next time the slot is recorded.
+        if(vkd.vkResetCommandPool(device, threadPool.pool, 0) != VK_SUCCESS)
+            throw std::runtime_error("failed to reset a frame command pool.");
+        threadPool.used[0] = 0;
+        threadPool.used[1] = 0;
+        resets++;
+    }
+}
+
+VkCommandBuffer FrameCommandPools::acquire(uint32_t thread, VkCommandBufferLevel level)
+{
+    if(thread >= threadPools.size())
+        throw std::runtime_error("frame command buffer asked for by an unknown recording thread.");
+
+    ThreadPool& threadPool = threadPools[thread];
+    std::vector<VkCommandBuffer>& buffers = threadPool.buffers[level];
+    uint32_t& used = threadPool.used[level];
+    if(used == buffers.size())
+    {
+        VkCommandBufferAllocateInfo allocateInfo = {};
+        allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocateInfo.commandPool = threadPool.pool;
+        allocateInfo.level = level;
+        allocateInfo.commandBufferCount = ALLOCATION_BATCH;
+
+        buffers.resize(used + ALLOCATION_BATCH);
+        if(vkd.vkAllocateCommandBuffers(device, &allocateInfo, buffers.data() + used) != VK_SUCCESS)
+        {
+            buffers.resize(used);
+            throw std::runtime_error("failed to allocate frame command buffers.");
+        }
+    }
+    return buffers[used++];
+}
+
+void FrameCommandPools::printReport(std::ostream& out) const
+{
+    size_t primaries = 0;
+    size_t secondaries = 0;
+    for(const ThreadPool& threadPool : threadPools)
+    {
+        primaries += threadPool.buffers[VK_COMMAND_BUFFER_LEVEL_PRIMARY].size();
+        secondaries += threadPool.buffers[VK_COMMAND_BUFFER_LEVEL_SECONDARY].size();
+    }
+    out << "Frame command pools: " << threadPools.size() << " threads, " << primaries << " primary and " << secondaries
+        << " secondary command buffers, " << resets << " pool resets" << std::endl;
+}
@@ -0,0 +1,45 @@
+#ifndef VECL_FRAMECOMMANDPOOLS_H
+#define VECL_FRAMECOMMANDPOOLS_H
+
+#include "VulkanDispatch.h"
+
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+//the command buffers of one frame slot. every recording thread has its own TRANSIENT pool in the slot, since a pool
+//can only be used by one thread at a time. buffers are never freed: reset() resets each pool with a single
+//vkResetCommandPool once the slot's frame is done on the GPU, and the same buffers are handed out again the next time
+//the slot comes around. that is cheaper than resetting buffers one by one and doesn't fragment the driver's memory.
+class FrameCommandPools
+{
+public:
+    void init(VkDevice device, uint32_t queueFamily, uint32_t threads);
+    //the GPU has to be done with the slot.
+    void destroy();
+
+    //call it after waiting for the slot's last frame and before any thread records into the slot again.
+    void reset();
+
+    //a command buffer for recording thread "thread" (0 to threads - 1), not begun yet. only that thread may call it
+    //while the slot is being recorded, and the buffer is only valid until the next reset().
+    VkCommandBuffer acquire(uint32_t thread, VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+    void printReport(std::ostream& out) const;
+
+private:
+    //one per thread, aligned so threads handing out buffers next to each other don't share a cache line.
+    struct alignas(64) ThreadPool
+    {
+        VkCommandPool pool = VK_NULL_HANDLE;
+        //primary and secondary buffers, the first "used" of each are handed out since the last reset.
+        std::vector<VkCommandBuffer> buffers[2];
+        uint32_t used[2] = {};
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    std::vector<ThreadPool> threadPools;
+    uint64_t resets = 0;
+};
+
+#endif //VECL_FRAMECOMMANDPOOLS_H
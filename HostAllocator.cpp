@@ -0,0 +1,233 @@
+#include "HostAllocator.h"
+
+#include "AllocationCounter.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ostream>
+
+HostAllocator hostAllocator;
+
+namespace
+{
+    //sits right in front of every pointer we hand out, it is how free() finds its way back to the slot.
+    struct AllocationHeader
+    {
+        uint16_t sizeClass;
+        uint16_t scope;
+        //distance from the start of the slot (or malloc block) to the pointer the driver got.
+        uint32_t offset;
+        uint64_t size;
+    };
+
+    const uint16_t LARGE_CLASS = 0xFFFF;
+
+    const char* const scopeNames[HostAllocationStats::SCOPE_COUNT] = {"command", "object", "cache", "device", "instance"};
+
+    AllocationHeader* headerOf(void* memory)
+    {
+        return reinterpret_cast<AllocationHeader*>(static_cast<char*>(memory) - sizeof(AllocationHeader));
+    }
+
+    int scopeIndex(VkSystemAllocationScope scope)
+    {
+        return (scope >= 0 && scope < HostAllocationStats::SCOPE_COUNT) ? static_cast<int>(scope) : 0;
+    }
+}
+
+HostAllocator::HostAllocator()
+{
+    allocationCallbacks.pUserData = this;
+    allocationCallbacks.pfnAllocation = allocationCallback;
+    allocationCallbacks.pfnReallocation = reallocationCallback;
+    allocationCallbacks.pfnFree = freeCallback;
+    allocationCallbacks.pfnInternalAllocation = internalAllocationCallback;
+    allocationCallbacks.pfnInternalFree = internalFreeCallback;
+}
+
+HostAllocator::~HostAllocator()
+{
+    for(Pool& pool : pools)
+    {
+        for(void* chunk : pool.chunks)
+            std::free(chunk);
+    }
+}
+
+void* HostAllocator::allocate(size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    if(size == 0)
+        return nullptr;
+    if(alignment == 0)
+        alignment = 1;
+
+    //room for the header plus whatever padding it takes to reach "alignment", slots and malloc blocks are 16 byte aligned.
+    size_t padding = std::max(sizeof(AllocationHeader), alignment);
+    size_t needed = size + padding;
+
+    int sizeClass = 0;
+    while(sizeClass < CLASS_COUNT && (SMALLEST_CLASS << sizeClass) < needed)
+        sizeClass++;
+
+    void* base;
+    if(sizeClass < CLASS_COUNT)
+        base = takeSlot(sizeClass);
+    else
+        base = std::malloc(needed);
+
+    if(base == nullptr)
+        return nullptr;
+
+    uintptr_t start = reinterpret_cast<uintptr_t>(base);
+    uintptr_t user = (start + sizeof(AllocationHeader) + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+
+    AllocationHeader* header = headerOf(reinterpret_cast<void*>(user));
+    header->sizeClass = sizeClass < CLASS_COUNT ? static_cast<uint16_t>(sizeClass) : LARGE_CLASS;
+    header->scope = static_cast<uint16_t>(scopeIndex(scope));
+    header->offset = static_cast<uint32_t>(user - start);
+    header->size = size;
+
+    countAllocation(scope, size);
+    allocationCounter.record(AllocationCounter::VULKAN_HOST, size);
+    return reinterpret_cast<void*>(user);
+}
+
+void* HostAllocator::reallocate(void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    if(original == nullptr)
+        return allocate(size, alignment, scope);
+
+    if(size == 0)
+    {
+        release(original);
+        return nullptr;
+    }
+
+    //the spec wants the old allocation left alone if this fails, so copy into a new one before letting go of it.
+    void* moved = allocate(size, alignment, scope);
+    if(moved == nullptr)
+        return nullptr;
+
+    std::memcpy(moved, original, std::min<size_t>(size, headerOf(original)->size));
+    release(original);
+    return moved;
+}
+
+void HostAllocator::release(void* memory)
+{
+    if(memory == nullptr)
+        return;
+
+    AllocationHeader* header = headerOf(memory);
+    void* base = static_cast<char*>(memory) - header->offset;
+    countFree(static_cast<VkSystemAllocationScope>(header->scope), header->size);
+
+    if(header->sizeClass == LARGE_CLASS)
+        std::free(base);
+    else
+        giveSlot(header->sizeClass, base);
+}
+
+void* HostAllocator::takeSlot(int sizeClass)
+{
+    Pool& pool = pools[sizeClass];
+    std::lock_guard<std::mutex> lock(pool.mutex);
+
+    if(pool.freeList == nullptr)
+    {
+        //out of slots, cut a new chunk into as many slots of this class as fit and put them all on the free list.
+        char* chunk = static_cast<char*>(std::malloc(CHUNK_SIZE));
+        if(chunk == nullptr)
+            return nullptr;
+        pool.chunks.push_back(chunk);
+
+        size_t slotSize = SMALLEST_CLASS << sizeClass;
+        for(size_t offset = 0; offset + slotSize <= CHUNK_SIZE; offset += slotSize)
+        {
+            void* slot = chunk + offset;
+            *static_cast<void**>(slot) = pool.freeList;
+            pool.freeList = slot;
+        }
+    }
+
+    void* slot = pool.freeList;
+    pool.freeList = *static_cast<void**>(slot);
+    return slot;
+}
+
+void HostAllocator::giveSlot(int sizeClass, void* slot)
+{
+    Pool& pool = pools[sizeClass];
+    std::lock_guard<std::mutex> lock(pool.mutex);
+
+    *static_cast<void**>(slot) = pool.freeList;
+    pool.freeList = slot;
+}
+
+void HostAllocator::countAllocation(VkSystemAllocationScope scope, size_t size)
+{
+    ScopeCounters& counters = scopes[scopeIndex(scope)];
+    size_t current = counters.currentBytes.fetch_add(size, std::memory_order_relaxed) + size;
+    counters.totalAllocations.fetch_add(1, std::memory_order_relaxed);
+
+    size_t peak = counters.peakBytes.load(std::memory_order_relaxed);
+    while(current > peak && !counters.peakBytes.compare_exchange_weak(peak, current, std::memory_order_relaxed))
+    {
+    }
+}
+
+void HostAllocator::countFree(VkSystemAllocationScope scope, size_t size)
+{
+    scopes[scopeIndex(scope)].currentBytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+HostAllocationStats HostAllocator::stats() const
+{
+    HostAllocationStats result;
+    for(int i = 0; i < HostAllocationStats::SCOPE_COUNT; i++)
+    {
+        result.currentBytes[i] = scopes[i].currentBytes.load(std::memory_order_relaxed);
+        result.peakBytes[i] = scopes[i].peakBytes.load(std::memory_order_relaxed);
+        result.totalAllocations[i] = scopes[i].totalAllocations.load(std::memory_order_relaxed);
+        result.internalBytes[i] = scopes[i].internalBytes.load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+void HostAllocator::printStats(std::ostream& out) const
+{
+    HostAllocationStats current = stats();
+    out << "Vulkan host allocations (scope: live bytes / peak bytes / allocations / driver internal bytes)" << std::endl;
+    for(int i = 0; i < HostAllocationStats::SCOPE_COUNT; i++)
+    {
+        out << "  " << scopeNames[i] << ": " << current.currentBytes[i] << " / " << current.peakBytes[i] << " / "
+            << current.totalAllocations[i] << " / " << current.internalBytes[i] << std::endl;
+    }
+}
+
+VKAPI_ATTR void* VKAPI_CALL HostAllocator::allocationCallback(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    return static_cast<HostAllocator*>(userData)->allocate(size, alignment, scope);
+}
+
+VKAPI_ATTR void* VKAPI_CALL HostAllocator::reallocationCallback(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    return static_cast<HostAllocator*>(userData)->reallocate(original, size, alignment, scope);
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::freeCallback(void* userData, void* memory)
+{
+    static_cast<HostAllocator*>(userData)->release(memory);
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::internalAllocationCallback(void* userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope)
+{
+    static_cast<HostAllocator*>(userData)->scopes[scopeIndex(scope)].internalBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::internalFreeCallback(void* userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope)
+{
+    static_cast<HostAllocator*>(userData)->scopes[scopeIndex(scope)].internalBytes.fetch_sub(size, std::memory_order_relaxed);
+}
@@ -0,0 +1,88 @@
+#ifndef VECL_HOSTALLOCATOR_H
+#define VECL_HOSTALLOCATOR_H
+
+#include "VulkanDispatch.h"
+
+#include <atomic>
+#include <cstddef>
+#include <iosfwd>
+#include <mutex>
+#include <vector>
+
+//bytes the driver asked us for, split by VkSystemAllocationScope (COMMAND, OBJECT, CACHE, DEVICE, INSTANCE).
+struct HostAllocationStats
+{
+    static const int SCOPE_COUNT = 5;
+
+    size_t currentBytes[SCOPE_COUNT] = {};
+    size_t peakBytes[SCOPE_COUNT] = {};
+    size_t totalAllocations[SCOPE_COUNT] = {};
+    //memory the driver allocated itself and only told us about (executable code and such).
+    size_t internalBytes[SCOPE_COUNT] = {};
+};
+
+//the VkAllocationCallbacks handed to every vkCreate*/vkDestroy* call.
+//small requests come out of fixed size classes that are carved from big chunks and never given back to the system
+//until the allocator dies, so the steady churn of small driver allocations doesn't fragment the heap.
+//anything too big for the largest class goes straight to malloc. all of it is counted per allocation scope.
+class HostAllocator
+{
+public:
+    HostAllocator();
+    ~HostAllocator();
+
+    HostAllocator(const HostAllocator&) = delete;
+    HostAllocator& operator=(const HostAllocator&) = delete;
+
+    const VkAllocationCallbacks* callbacks() const { return &allocationCallbacks; }
+
+    HostAllocationStats stats() const;
+    void printStats(std::ostream& out) const;
+
+private:
+    //requests up to 4 KiB (header and alignment padding included) are pooled, in powers of two from 64 bytes.
+    static const int CLASS_COUNT = 7;
+    static const size_t SMALLEST_CLASS = 64;
+    static const size_t CHUNK_SIZE = 64 * 1024;
+
+    struct Pool
+    {
+        std::mutex mutex;
+        //unused slots, linked through their first bytes.
+        void* freeList = nullptr;
+        std::vector<void*> chunks;
+    };
+
+    struct ScopeCounters
+    {
+        std::atomic<size_t> currentBytes{0};
+        std::atomic<size_t> peakBytes{0};
+        std::atomic<size_t> totalAllocations{0};
+        std::atomic<size_t> internalBytes{0};
+    };
+
+    void* allocate(size_t size, size_t alignment, VkSystemAllocationScope scope);
+    void* reallocate(void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    void release(void* memory);
+
+    void* takeSlot(int sizeClass);
+    void giveSlot(int sizeClass, void* slot);
+
+    void countAllocation(VkSystemAllocationScope scope, size_t size);
+    void countFree(VkSystemAllocationScope scope, size_t size);
+
+    static VKAPI_ATTR void* VKAPI_CALL allocationCallback(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    static VKAPI_ATTR void* VKAPI_CALL reallocationCallback(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    static VKAPI_ATTR void VKAPI_CALL freeCallback(void* userData, void* memory);
+    static VKAPI_ATTR void VKAPI_CALL internalAllocationCallback(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+    static VKAPI_ATTR void VKAPI_CALL internalFreeCallback(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+
+    VkAllocationCallbacks allocationCallbacks = {};
+    Pool pools[CLASS_COUNT];
+    ScopeCounters scopes[HostAllocationStats::SCOPE_COUNT];
+};
+
+//the allocator every Vulkan object in the process is created and destroyed with.
+extern HostAllocator hostAllocator;
+
+#endif //VECL_HOSTALLOCATOR_H
@@ -0,0 +1,1016 @@
+#include "PipelineRegistry.h"
+
+#include "DeviceFeatures.h"
+#include "HostAllocator.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+
+namespace
+{
+    //bump this whenever PipelineState changes meaning, older manifests are then ignored. a change in size is caught anyway.
+    const int MANIFEST_VERSION = 1;
+    const char* const MANIFEST_MAGIC = "vecl-pipeline-manifest";
+
+    //the order of the parts in PipelineRegistry::Entry::parts.
+    const VkGraphicsPipelineLibraryFlagBitsEXT libraryParts[] = {
+        VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT, VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT,
+        VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT, VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT};
+    static_assert(sizeof(libraryParts) / sizeof(libraryParts[0]) == 4, "one flag per library part.");
+
+    //the formats and sample count of a render pass, everything render pass compatibility depends on for one subpass.
+    struct RenderPassKey
+    {
+        uint32_t colorCount;
+        VkFormat colorFormats[PipelineState::MAX_COLOR_TARGETS];
+        VkFormat depthFormat;
+        VkSampleCountFlagBits samples;
+    };
+
+    //dynamic topology can only switch within a class (points, lines, triangles), the pipeline is made for the class.
+    VkPrimitiveTopology topologyClass(VkPrimitiveTopology topology)
+    {
+        switch(topology)
+        {
+        case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+        case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+            return VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+        case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST:
+        case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP:
+        case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_FAN:
+            return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        default:
+            return topology;
+        }
+    }
+
+    //clears everything past the counts so states that only differ in unused slots are the same state, and resets the
+    //fields that are set while recording on this device so they don't split pipelines either.
+    PipelineState canonical(const PipelineState& state)
+    {
+        if(state.specializationCount > PipelineState::MAX_SPECIALIZATION || state.vertexBindingCount > PipelineState::MAX_VERTEX_BINDINGS ||
+           state.vertexAttributeCount > PipelineState::MAX_VERTEX_ATTRIBUTES || state.colorCount > PipelineState::MAX_COLOR_TARGETS)
+            throw std::runtime_error("pipeline state with more entries than it has room for.");
+
+        PipelineState result = state;
+        for(uint32_t i = state.specializationCount; i < PipelineState::MAX_SPECIALIZATION; i++)
+            result.specialization[i] = {};
+        for(uint32_t i = state.vertexBindingCount; i < PipelineState::MAX_VERTEX_BINDINGS; i++)
+            result.vertexBindings[i] = {};
+        for(uint32_t i = state.vertexAttributeCount; i < PipelineState::MAX_VERTEX_ATTRIBUTES; i++)
+            result.vertexAttributes[i] = {};
+        for(uint32_t i = state.colorCount; i < PipelineState::MAX_COLOR_TARGETS; i++)
+        {
+            result.colorFormats[i] = VK_FORMAT_UNDEFINED;
+            result.blend[i] = {};
+        }
+
+        const PipelineState defaults;
+        if(capabilities.extendedDynamicState)
+        {
+            result.cullMode = defaults.cullMode;
+            result.frontFace = defaults.frontFace;
+            result.topology = topologyClass(state.topology);
+            result.depthTest = defaults.depthTest;
+            result.depthWrite = defaults.depthWrite;
+            result.depthCompare = defaults.depthCompare;
+        }
+        if(capabilities.extendedDynamicState2)
+        {
+            result.depthBias = defaults.depthBias;
+            result.primitiveRestart = defaults.primitiveRestart;
+        }
+        if(capabilities.extendedDynamicState3)
+        {
+            result.polygonMode = defaults.polygonMode;
+            result.alphaToCoverage = defaults.alphaToCoverage;
+            for(uint32_t i = 0; i < PipelineState::MAX_COLOR_TARGETS; i++)
+                result.blend[i] = {};
+        }
+        if(capabilities.vertexInputDynamicState)
+        {
+            result.vertexBindingCount = 0;
+            result.vertexAttributeCount = 0;
+            for(VkVertexInputBindingDescription& binding : result.vertexBindings)
+                binding = {};
+            for(VkVertexInputAttributeDescription& attribute : result.vertexAttributes)
+                attribute = {};
+        }
+        return result;
+    }
+
+    std::string toHex(const void* data, size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        std::string hex;
+        char digits[3];
+        for(size_t i = 0; i < size; i++)
+        {
+            std::snprintf(digits, sizeof(digits), "%02x", bytes[i]);
+            hex += digits;
+        }
+        return hex;
+    }
+
+    bool fromHex(const std::string& hex, void* data, size_t size)
+    {
+        if(hex.size() != size * 2)
+            return false;
+        unsigned char* bytes = static_cast<unsigned char*>(data);
+        for(size_t i = 0; i < size; i++)
+        {
+            unsigned int value;
+            if(std::sscanf(hex.c_str() + i * 2, "%2x", &value) != 1)
+                return false;
+            bytes[i] = static_cast<unsigned char>(value);
+        }
+        return true;
+    }
+
+    //every create info of a graphics pipeline, filled in from a state. they point at each other, so the struct stays
+    //where it was made. "info" describes the whole pipeline, part() narrows it down to one library.
+    struct PipelineDescription
+    {
+        VkSpecializationMapEntry mapEntries[PipelineState::MAX_SPECIALIZATION] = {};
+        uint32_t values[PipelineState::MAX_SPECIALIZATION] = {};
+        VkSpecializationInfo specializationInfo = {};
+        //the vertex stage first, the fragment stage (if any) after it.
+        VkPipelineShaderStageCreateInfo stages[2] = {};
+        VkPipelineVertexInputStateCreateInfo vertexInput = {};
+        VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+        VkPipelineViewportStateCreateInfo viewport = {};
+        VkPipelineRasterizationStateCreateInfo rasterization = {};
+        VkPipelineMultisampleStateCreateInfo multisample = {};
+        VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+        VkPipelineColorBlendStateCreateInfo colorBlend = {};
+        VkDynamicState dynamicStates[32] = {};
+        VkPipelineDynamicStateCreateInfo dynamic = {};
+        VkPipelineRenderingCreateInfo rendering = {};
+        VkGraphicsPipelineCreateInfo info = {};
+
+        PipelineDescription(const PipelineState& state, VkShaderModule vertex, VkShaderModule fragment, VkPipelineLayout layout, VkRenderPass renderPass);
+        PipelineDescription(const PipelineDescription&) = delete;
+        PipelineDescription& operator=(const PipelineDescription&) = delete;
+
+        //the create info of the library for "part", "libraryInfo" is chained into it.
+        VkGraphicsPipelineCreateInfo part(VkGraphicsPipelineLibraryFlagBitsEXT part, VkGraphicsPipelineLibraryCreateInfoEXT& libraryInfo) const;
+    };
+
+    PipelineDescription::PipelineDescription(const PipelineState& state, VkShaderModule vertex, VkShaderModule fragment, VkPipelineLayout layout, VkRenderPass renderPass)
+    {
+        for(uint32_t i = 0; i < state.specializationCount; i++)
+        {
+            mapEntries[i].constantID = state.specialization[i].id;
+            mapEntries[i].offset = i * sizeof(uint32_t);
+            mapEntries[i].size = sizeof(uint32_t);
+            values[i] = state.specialization[i].value;
+        }
+
+        specializationInfo.mapEntryCount = state.specializationCount;
+        specializationInfo.pMapEntries = mapEntries;
+        specializationInfo.dataSize = state.specializationCount * sizeof(uint32_t);
+        specializationInfo.pData = values;
+
+        uint32_t stageCount = 0;
+        VkShaderModule modules[2] = {vertex, fragment};
+        VkShaderStageFlagBits stageBits[2] = {VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT};
+        for(int i = 0; i < 2; i++)
+        {
+            if(modules[i] == VK_NULL_HANDLE)
+                continue;
+            VkPipelineShaderStageCreateInfo& stage = stages[stageCount++];
+            stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            stage.stage = stageBits[i];
+            stage.module = modules[i];
+            stage.pName = "main";
+            stage.pSpecializationInfo = state.specializationCount > 0 ? &specializationInfo : nullptr;
+        }
+
+        vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        vertexInput.vertexBindingDescriptionCount = state.vertexBindingCount;
+        vertexInput.pVertexBindingDescriptions = state.vertexBindings;
+        vertexInput.vertexAttributeDescriptionCount = state.vertexAttributeCount;
+        vertexInput.pVertexAttributeDescriptions = state.vertexAttributes;
+
+        inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+        inputAssembly.topology = state.topology;
+        inputAssembly.primitiveRestartEnable = state.primitiveRestart;
+
+        //viewport and scissor are always set while recording, a window resize doesn't need new pipelines.
+        viewport.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        viewport.viewportCount = 1;
+        viewport.scissorCount = 1;
+
+        rasterization.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+        rasterization.polygonMode = state.polygonMode;
+        rasterization.cullMode = state.cullMode;
+        rasterization.frontFace = state.frontFace;
+        rasterization.depthBiasEnable = state.depthBias;
+        rasterization.lineWidth = 1.0f;
+
+        multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+        multisample.rasterizationSamples = state.samples;
+        multisample.alphaToCoverageEnable = state.alphaToCoverage;
+
+        depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+        depthStencil.depthTestEnable = state.depthTest;
+        depthStencil.depthWriteEnable = state.depthWrite;
+        depthStencil.depthCompareOp = state.depthCompare;
+
+        colorBlend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        colorBlend.attachmentCount = state.colorCount;
+        colorBlend.pAttachments = state.blend;
+
+        //everything canonical() cleared is set while recording instead (PipelineRegistry::setDynamicState()).
+        uint32_t dynamicCount = 0;
+        dynamicStates[dynamicCount++] = VK_DYNAMIC_STATE_VIEWPORT;
+        dynamicStates[dynamicCount++] = VK_DYNAMIC_STATE_SCISSOR;
+        //the bias factors are core dynamic state, they are set while recording on every device (see DepthBias).
+        dynamicStates[dynamicCount++] = VK_DYNAMIC_STATE_DEPTH_BIAS;
+        if(capabilities.extendedDynamicState)
+        {
+            dynamicStates[dynamicCount++] = VK_DYNAMIC_STATE_CULL_MODE;
+            dynamicStates[dynamicCount++] = VK_DYNAMIC_STATE_FRONT_FACE;
+            dynamicStates[dynamicCount++] = VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY;
+            dynamicStates[dynamicCount++] = VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE;
+            dynamicStates[dynamicCount++] = VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE;
+            dynamicStates[dynamicCount++] = VK_DYNAMIC_STATE_DEPTH_COMPARE_OP;
+        }
+        if(capabilities.extendedDynamicState2)
+        {
+            dynamicStates[dynamicCount++] = VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE;
+            dynamicStates[dynamicCount++] = VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE;
+        }
+        if(capabilities.extendedDynamicState3)
+        {
+            dynamicStates[dynamicCount++] = VK_DYNAMIC_STATE_POLYGON_MODE_EXT;
+            dynamicStates[dynamicCount++] = VK_DYNAMIC_STATE_ALPHA_TO_COVERAGE_ENABLE_EXT;
+            dynamicStates[dynamicCount++] = VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT;
+            dynamicStates[dynamicCount++] = VK_DYNAMIC_STATE_COLOR_BLEND_EQUATION_EXT;
+            dynamicStates[dynamicCount++] = VK_DYNAMIC_STATE_COLOR_WRITE_MASK_EXT;
+        }
+        if(capabilities.vertexInputDynamicState)
+            dynamicStates[dynamicCount++] = VK_DYNAMIC_STATE_VERTEX_INPUT_EXT;
+
+        dynamic.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamic.dynamicStateCount = dynamicCount;
+        dynamic.pDynamicStates = dynamicStates;
+
+        rendering.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+        rendering.colorAttachmentCount = state.colorCount;
+        rendering.pColorAttachmentFormats = state.colorFormats;
+        rendering.depthAttachmentFormat = hasDepthAspect(state.depthFormat) ? state.depthFormat : VK_FORMAT_UNDEFINED;
+        rendering.stencilAttachmentFormat = hasStencilAspect(state.depthFormat) ? state.depthFormat : VK_FORMAT_UNDEFINED;
+
+        info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        info.pNext = renderPass == VK_NULL_HANDLE ? &rendering : nullptr;
+        info.stageCount = stageCount;
+        info.pStages = stages;
+        info.pVertexInputState = capabilities.vertexInputDynamicState ? nullptr : &vertexInput;
+        info.pInputAssemblyState = &inputAssembly;
+        info.pViewportState = &viewport;
+        info.pRasterizationState = &rasterization;
+        info.pMultisampleState = &multisample;
+        info.pDepthStencilState = &depthStencil;
+        info.pColorBlendState = &colorBlend;
+        info.pDynamicState = &dynamic;
+        info.layout = layout;
+        info.renderPass = renderPass;
+        info.basePipelineIndex = -1;
+    }
+
+    VkGraphicsPipelineCreateInfo PipelineDescription::part(VkGraphicsPipelineLibraryFlagBitsEXT part, VkGraphicsPipelineLibraryCreateInfoEXT& libraryInfo) const
+    {
+        libraryInfo = {};
+        libraryInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+        libraryInfo.pNext = info.pNext;
+        libraryInfo.flags = part;
+
+        //the optimized link needs what the parts were compiled from, so they keep it around.
+        VkGraphicsPipelineCreateInfo result = {};
+        result.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        result.pNext = &libraryInfo;
+        result.flags = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+        result.pDynamicState = info.pDynamicState;
+        result.basePipelineIndex = -1;
+        switch(part)
+        {
+        case VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT:
+            result.pVertexInputState = info.pVertexInputState;
+            result.pInputAssemblyState = info.pInputAssemblyState;
+            break;
+        case VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT:
+            result.stageCount = 1;
+            result.pStages = &stages[0];
+            result.pViewportState = info.pViewportState;
+            result.pRasterizationState = info.pRasterizationState;
+            result.layout = info.layout;
+            result.renderPass = info.renderPass;
+            break;
+        case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT:
+            //depth only states have no fragment stage, the part still carries the depth test.
+            result.stageCount = info.stageCount - 1;
+            result.pStages = &stages[1];
+            result.pMultisampleState = info.pMultisampleState;
+            result.pDepthStencilState = info.pDepthStencilState;
+            result.layout = info.layout;
+            result.renderPass = info.renderPass;
+            break;
+        case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT:
+            result.pMultisampleState = info.pMultisampleState;
+            result.pColorBlendState = info.pColorBlendState;
+            result.renderPass = info.renderPass;
+            break;
+        }
+        return result;
+    }
+
+    //a hash of the part and the fields of "state" its library is made from, states that agree on them share it.
+    uint64_t libraryKey(VkGraphicsPipelineLibraryFlagBitsEXT part, const PipelineState& state)
+    {
+        uint64_t key = hashBytes(&part, sizeof(part));
+        auto add = [&key](const auto& field) { key = hashBytes(&field, sizeof(field), key); };
+        //the shader parts are made against a render pass when there is no dynamic rendering.
+        bool renderPass = !capabilities.dynamicRendering;
+        switch(part)
+        {
+        case VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT:
+            add(state.vertexBindingCount);
+            add(state.vertexBindings);
+            add(state.vertexAttributeCount);
+            add(state.vertexAttributes);
+            add(state.topology);
+            add(state.primitiveRestart);
+            return key;
+        case VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT:
+            add(state.vertexShader);
+            add(state.layout);
+            add(state.specializationCount);
+            add(state.specialization);
+            add(state.polygonMode);
+            add(state.cullMode);
+            add(state.frontFace);
+            add(state.depthBias);
+            break;
+        case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT:
+            add(state.fragmentShader);
+            add(state.layout);
+            add(state.specializationCount);
+            add(state.specialization);
+            add(state.depthTest);
+            add(state.depthWrite);
+            add(state.depthCompare);
+            add(state.samples);
+            add(state.alphaToCoverage);
+            break;
+        case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT:
+            add(state.blend);
+            add(state.samples);
+            add(state.alphaToCoverage);
+            renderPass = true;
+            break;
+        }
+        if(renderPass)
+        {
+            add(state.colorCount);
+            add(state.colorFormats);
+            add(state.depthFormat);
+            add(state.samples);
+        }
+        return key;
+    }
+}
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed;
+    for(size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+bool hasDepthAspect(VkFormat format)
+{
+    return format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_X8_D24_UNORM_PACK32 || format == VK_FORMAT_D32_SFLOAT ||
+           format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+
+bool hasStencilAspect(VkFormat format)
+{
+    return format == VK_FORMAT_S8_UINT || format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT ||
+           format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+
+size_t PipelineRegistry::StateHash::operator()(const PipelineState& state) const
+{
+    return static_cast<size_t>(hashBytes(&state, sizeof(state)));
+}
+
+bool PipelineRegistry::StateEqual::operator()(const PipelineState& a, const PipelineState& b) const
+{
+    return std::memcmp(&a, &b, sizeof(PipelineState)) == 0;
+}
+
+void PipelineRegistry::init(VkDevice device, uint32_t workers)
+{
+    this->device = device;
+
+    VkPipelineCacheCreateInfo cacheInfo = {};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    if(vkd.vkCreatePipelineCache(device, &cacheInfo, hostAllocator.callbacks(), &pipelineCache) != VK_SUCCESS)
+        throw std::runtime_error("failed to create the pipeline cache.");
+
+    stopping = false;
+    for(uint32_t i = 0; i < workers; i++)
+        threads.emplace_back(&PipelineRegistry::run, this);
+}
+
+void PipelineRegistry::destroy()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for(std::thread& thread : threads)
+        thread.join();
+    threads.clear();
+
+    for(auto& entry : pipelines)
+    {
+        if(entry.second.pipeline != VK_NULL_HANDLE)
+            vkd.vkDestroyPipeline(device, entry.second.pipeline, hostAllocator.callbacks());
+    }
+    pipelines.clear();
+    for(VkPipeline pipeline : retired)
+        vkd.vkDestroyPipeline(device, pipeline, hostAllocator.callbacks());
+    retired.clear();
+    //linked pipelines don't need their libraries anymore, but they go after them anyway.
+    for(auto& entry : libraries)
+        vkd.vkDestroyPipeline(device, entry.second, hostAllocator.callbacks());
+    libraries.clear();
+    for(auto& entry : shaders)
+        vkd.vkDestroyShaderModule(device, entry.second, hostAllocator.callbacks());
+    shaders.clear();
+    for(auto& entry : renderPasses)
+        vkd.vkDestroyRenderPass(device, entry.second, hostAllocator.callbacks());
+    renderPasses.clear();
+    layouts.clear();
+    usage.clear();
+    manifest.clear();
+
+    if(pipelineCache != VK_NULL_HANDLE)
+        vkd.vkDestroyPipelineCache(device, pipelineCache, hostAllocator.callbacks());
+    pipelineCache = VK_NULL_HANDLE;
+}
+
+uint64_t PipelineRegistry::addShader(const uint32_t* code, size_t codeSize)
+{
+    uint64_t id = hashBytes(code, codeSize);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if(shaders.count(id) != 0)
+        return id;
+
+    VkShaderModuleCreateInfo moduleInfo = {};
+    moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleInfo.codeSize = codeSize;
+    moduleInfo.pCode = code;
+
+    VkShaderModule module;
+    if(vkd.vkCreateShaderModule(device, &moduleInfo, hostAllocator.callbacks(), &module) != VK_SUCCESS)
+        throw std::runtime_error("failed to create a shader module.");
+    shaders.emplace(id, module);
+    return id;
+}
+
+uint64_t PipelineRegistry::addLayout(const char* name, VkPipelineLayout layout)
+{
+    uint64_t id = hashBytes(name, std::strlen(name));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = layouts.find(id);
+    if(found != layouts.end() && found->second != layout)
+        throw std::runtime_error(std::string("pipeline layout \"") + name + "\" registered twice.");
+    layouts[id] = layout;
+    return id;
+}
+
+VkPipelineLayout PipelineRegistry::layout(uint64_t id) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = layouts.find(id);
+    return found != layouts.end() ? found->second : VK_NULL_HANDLE;
+}
+
+VkPipeline PipelineRegistry::get(const PipelineState& state)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    bool added;
+    PipelineMap::value_type& entry = lookup(state, added);
+    markUsed(entry, state);
+
+    switch(entry.second.status)
+    {
+    case READY:
+        hits++;
+        return entry.second.pipeline;
+    case QUEUED:
+        //new, or waiting in the background queue: compiling it here is faster than waiting for it to come up.
+        hotCompiles++;
+        compile(entry, lock);
+        break;
+    case COMPILING:
+        sharedCompiles++;
+        compiled.wait(lock, [&entry] { return entry.second.status != COMPILING; });
+        break;
+    case FAILED:
+        break;
+    }
+
+    if(entry.second.status != READY)
+        throw std::runtime_error("failed to create a graphics pipeline.");
+    return entry.second.pipeline;
+}
+
+VkPipeline PipelineRegistry::bind(VkCommandBuffer commandBuffer, const PipelineState& state, const DepthBias& depthBias)
+{
+    VkPipeline pipeline = get(state);
+    vkd.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    setDynamicState(commandBuffer, state, depthBias);
+    return pipeline;
+}
+
+void PipelineRegistry::setDynamicState(VkCommandBuffer commandBuffer, const PipelineState& state, const DepthBias& depthBias) const
+{
+    //the factors only have to be set for draws that have depth bias enabled.
+    if(state.depthBias)
+        vkd.vkCmdSetDepthBias(commandBuffer, depthBias.constant, depthBias.clamp, depthBias.slope);
+
+    if(capabilities.extendedDynamicState)
+    {
+        vkd.vkCmdSetCullMode(commandBuffer, state.cullMode);
+        vkd.vkCmdSetFrontFace(commandBuffer, state.frontFace);
+        vkd.vkCmdSetPrimitiveTopology(commandBuffer, state.topology);
+        vkd.vkCmdSetDepthTestEnable(commandBuffer, state.depthTest);
+        vkd.vkCmdSetDepthWriteEnable(commandBuffer, state.depthWrite);
+        vkd.vkCmdSetDepthCompareOp(commandBuffer, state.depthCompare);
+    }
+    if(capabilities.extendedDynamicState2)
+    {
+        vkd.vkCmdSetDepthBiasEnable(commandBuffer, state.depthBias);
+        vkd.vkCmdSetPrimitiveRestartEnable(commandBuffer, state.primitiveRestart);
+    }
+    if(capabilities.extendedDynamicState3)
+    {
+        vkd.vkCmdSetPolygonModeEXT(commandBuffer, state.polygonMode);
+        vkd.vkCmdSetAlphaToCoverageEnableEXT(commandBuffer, state.alphaToCoverage);
+        if(state.colorCount > 0)
+        {
+            VkBool32 enables[PipelineState::MAX_COLOR_TARGETS];
+            VkColorBlendEquationEXT equations[PipelineState::MAX_COLOR_TARGETS];
+            VkColorComponentFlags writeMasks[PipelineState::MAX_COLOR_TARGETS];
+            for(uint32_t i = 0; i < state.colorCount; i++)
+            {
+                const VkPipelineColorBlendAttachmentState& blend = state.blend[i];
+                enables[i] = blend.blendEnable;
+                equations[i] = {blend.srcColorBlendFactor, blend.dstColorBlendFactor, blend.colorBlendOp,
+                                blend.srcAlphaBlendFactor, blend.dstAlphaBlendFactor, blend.alphaBlendOp};
+                writeMasks[i] = blend.colorWriteMask;
+            }
+            vkd.vkCmdSetColorBlendEnableEXT(commandBuffer, 0, state.colorCount, enables);
+            vkd.vkCmdSetColorBlendEquationEXT(commandBuffer, 0, state.colorCount, equations);
+            vkd.vkCmdSetColorWriteMaskEXT(commandBuffer, 0, state.colorCount, writeMasks);
+        }
+    }
+    if(capabilities.vertexInputDynamicState)
+    {
+        VkVertexInputBindingDescription2EXT bindings[PipelineState::MAX_VERTEX_BINDINGS];
+        VkVertexInputAttributeDescription2EXT attributes[PipelineState::MAX_VERTEX_ATTRIBUTES];
+        for(uint32_t i = 0; i < state.vertexBindingCount; i++)
+        {
+            bindings[i] = {};
+            bindings[i].sType = VK_STRUCTURE_TYPE_VERTEX_INPUT_BINDING_DESCRIPTION_2_EXT;
+            bindings[i].binding = state.vertexBindings[i].binding;
+            bindings[i].stride = state.vertexBindings[i].stride;
+            bindings[i].inputRate = state.vertexBindings[i].inputRate;
+            bindings[i].divisor = 1;
+        }
+        for(uint32_t i = 0; i < state.vertexAttributeCount; i++)
+        {
+            attributes[i] = {};
+            attributes[i].sType = VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT;
+            attributes[i].location = state.vertexAttributes[i].location;
+            attributes[i].binding = state.vertexAttributes[i].binding;
+            attributes[i].format = state.vertexAttributes[i].format;
+            attributes[i].offset = state.vertexAttributes[i].offset;
+        }
+        vkd.vkCmdSetVertexInputEXT(commandBuffer, state.vertexBindingCount, bindings, state.vertexAttributeCount, attributes);
+    }
+}
+
+VkPipeline PipelineRegistry::find(const PipelineState& state)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    bool added;
+    PipelineMap::value_type& entry = lookup(state, added);
+    markUsed(entry, state);
+
+    if(entry.second.status == FAILED)
+        throw std::runtime_error("failed to create a graphics pipeline.");
+    if(entry.second.status == READY)
+    {
+        hits++;
+        return entry.second.pipeline;
+    }
+
+    if(added)
+    {
+        queue.push_back({&entry, false});
+        lock.unlock();
+        workAvailable.notify_one();
+    }
+    return VK_NULL_HANDLE;
+}
+
+void PipelineRegistry::prepare(const PipelineState& state)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    bool added;
+    PipelineMap::value_type& entry = lookup(state, added);
+    if(!added)
+        return;
+
+    queue.push_back({&entry, false});
+    lock.unlock();
+    workAvailable.notify_one();
+}
+
+void PipelineRegistry::waitIdle()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    compiled.wait(lock, [this] { return queue.empty() && compiling == 0; });
+}
+
+size_t PipelineRegistry::warmUp(const std::string& path)
+{
+    std::ifstream file(path);
+    if(!file)
+        return 0;
+
+    std::string magic;
+    int version = 0;
+    size_t stateSize = 0;
+    if(!(file >> magic >> version >> stateSize) || magic != MANIFEST_MAGIC || version != MANIFEST_VERSION || stateSize != sizeof(PipelineState))
+        return 0;
+
+    std::vector<PipelineState> states;
+    std::string line;
+    while(std::getline(file, line))
+    {
+        std::istringstream fields(line);
+        std::string kind;
+        std::string hex;
+        unsigned char bytes[sizeof(PipelineState)];
+        if(!(fields >> kind >> hex) || kind != "state" || !fromHex(hex, bytes, sizeof(bytes)))
+            continue;
+
+        PipelineState state;
+        std::memcpy(&state, bytes, sizeof(state));
+        //a damaged line would make canonical() throw later on.
+        if(state.specializationCount > PipelineState::MAX_SPECIALIZATION || state.vertexBindingCount > PipelineState::MAX_VERTEX_BINDINGS ||
+           state.vertexAttributeCount > PipelineState::MAX_VERTEX_ATTRIBUTES || state.colorCount > PipelineState::MAX_COLOR_TARGETS)
+            continue;
+        states.push_back(state);
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    manifest.clear();
+    size_t queued = 0;
+    for(const PipelineState& state : states)
+    {
+        //compiling a state with an unknown shader or layout would only mark it FAILED for the rest of the session, and
+        //keeping it would carry it from manifest to manifest forever.
+        if(!knows(state))
+            continue;
+        manifest.push_back(state);
+
+        bool added;
+        PipelineMap::value_type& entry = lookup(state, added);
+        if(!added)
+            continue;
+        queue.push_back({&entry, false});
+        queued++;
+    }
+    warmedUp += queued;
+    lock.unlock();
+    workAvailable.notify_all();
+    return queued;
+}
+
+void PipelineRegistry::saveManifest(const std::string& path) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if(usage.empty())
+        return;
+
+    std::ofstream file(path, std::ios::trunc);
+    if(!file)
+        return;
+
+    //states that only differ in what this device sets while recording are written once, the first one stands for all.
+    std::unordered_set<PipelineState, StateHash, StateEqual> written;
+    file << MANIFEST_MAGIC << " " << MANIFEST_VERSION << " " << sizeof(PipelineState) << "\n";
+    for(const std::vector<PipelineState>* states : {&usage, &manifest})
+    {
+        for(const PipelineState& state : *states)
+        {
+            if(knows(state) && written.insert(canonical(state)).second)
+                file << "state " << toHex(&state, sizeof(state)) << "\n";
+        }
+    }
+}
+
+size_t PipelineRegistry::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return pipelines.size();
+}
+
+void PipelineRegistry::printReport(std::ostream& out) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    out << "Pipelines: " << pipelines.size() << " states, " << compiles << " compiled in " << compileMilliseconds
+        << " ms, " << hits << " lookups shared an existing pipeline, " << sharedCompiles
+        << " waited for a compile already running";
+    out << ", " << warmedUp << " warmed up, " << hotCompiles << " compiled while drawing";
+    if(capabilities.graphicsPipelineLibrary)
+        out << ", " << libraryCompiles << " libraries, " << optimizedLinks << " optimized links";
+    out << std::endl;
+}
+
+PipelineRegistry::PipelineMap::value_type& PipelineRegistry::lookup(const PipelineState& state, bool& added)
+{
+    auto result = pipelines.emplace(canonical(state), Entry());
+    added = result.second;
+    return *result.first;
+}
+
+bool PipelineRegistry::knows(const PipelineState& state) const
+{
+    return shaders.count(state.vertexShader) != 0 && (state.fragmentShader == 0 || shaders.count(state.fragmentShader) != 0) &&
+           layouts.count(state.layout) != 0;
+}
+
+void PipelineRegistry::markUsed(PipelineMap::value_type& entry, const PipelineState& state)
+{
+    if(entry.second.used)
+        return;
+    entry.second.used = true;
+    usage.push_back(state);
+}
+
+void PipelineRegistry::compile(PipelineMap::value_type& entry, std::unique_lock<std::mutex>& lock)
+{
+    entry.second.status = COMPILING;
+    compiling++;
+
+    const PipelineState& state = entry.first;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    double milliseconds = 0.0;
+    try
+    {
+        auto vertex = shaders.find(state.vertexShader);
+        auto fragment = shaders.find(state.fragmentShader);
+        auto layout = layouts.find(state.layout);
+        if(vertex == shaders.end() || (state.fragmentShader != 0 && fragment == shaders.end()) || layout == layouts.end())
+            throw std::runtime_error("pipeline state with an unknown shader or layout.");
+        //the handles are copied out, addShader() and addLayout() may rehash the maps once the lock is released.
+        VkShaderModule vertexModule = vertex->second;
+        VkShaderModule fragmentModule = state.fragmentShader != 0 ? fragment->second : VK_NULL_HANDLE;
+        VkPipelineLayout pipelineLayout = layout->second;
+        VkRenderPass renderPass = capabilities.dynamicRendering ? VK_NULL_HANDLE : compatibleRenderPass(state);
+
+        //the state is a key of the map and never changes, it can be read without the lock. so can the parts, nobody
+        //else touches an entry while it is COMPILING.
+        lock.unlock();
+        auto start = std::chrono::steady_clock::now();
+        if(capabilities.graphicsPipelineLibrary)
+        {
+            for(uint32_t i = 0; i < LIBRARY_PARTS; i++)
+                entry.second.parts[i] = library(libraryParts[i], state, vertexModule, fragmentModule, pipelineLayout, renderPass);
+            pipeline = link(entry.second.parts, pipelineLayout, false);
+        }
+        else
+            pipeline = createPipeline(state, vertexModule, fragmentModule, pipelineLayout, renderPass);
+        milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        lock.lock();
+    }
+    catch(const std::exception&)
+    {
+        if(!lock.owns_lock())
+            lock.lock();
+    }
+
+    entry.second.pipeline = pipeline;
+    entry.second.status = pipeline != VK_NULL_HANDLE ? READY : FAILED;
+    compiles++;
+    compileMilliseconds += milliseconds;
+    compiling--;
+    compiled.notify_all();
+
+    //the fast link is good enough to draw with right away, the optimized one takes its place when it is done.
+    if(capabilities.graphicsPipelineLibrary && pipeline != VK_NULL_HANDLE && !threads.empty())
+    {
+        queue.push_back({&entry, true});
+        workAvailable.notify_one();
+    }
+}
+
+void PipelineRegistry::optimize(PipelineMap::value_type& entry, std::unique_lock<std::mutex>& lock)
+{
+    entry.second.optimized = true;
+    compiling++;
+    VkPipelineLayout layout = layouts.at(entry.first.layout);
+
+    //keeps the fast linked pipeline if the optimized link fails, it works just the same.
+    lock.unlock();
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    try
+    {
+        pipeline = link(entry.second.parts, layout, true);
+    }
+    catch(const std::exception&)
+    {
+    }
+    lock.lock();
+
+    if(pipeline != VK_NULL_HANDLE)
+    {
+        retired.push_back(entry.second.pipeline);
+        entry.second.pipeline = pipeline;
+        optimizedLinks++;
+    }
+    compiling--;
+    compiled.notify_all();
+}
+
+VkPipeline PipelineRegistry::createPipeline(const PipelineState& state, VkShaderModule vertex, VkShaderModule fragment, VkPipelineLayout layout, VkRenderPass renderPass)
+{
+    PipelineDescription description(state, vertex, fragment, layout, renderPass);
+    VkPipeline pipeline;
+    if(vkd.vkCreateGraphicsPipelines(device, pipelineCache, 1, &description.info, hostAllocator.callbacks(), &pipeline) != VK_SUCCESS)
+        throw std::runtime_error("failed to create a graphics pipeline.");
+    return pipeline;
+}
+
+VkPipeline PipelineRegistry::library(VkGraphicsPipelineLibraryFlagBitsEXT part, const PipelineState& state, VkShaderModule vertex, VkShaderModule fragment, VkPipelineLayout layout, VkRenderPass renderPass)
+{
+    uint64_t key = libraryKey(part, state);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = libraries.find(key);
+        if(found != libraries.end())
+            return found->second;
+    }
+
+    //compiled without the lock. two threads can end up making the same part, the second one throws its copy away.
+    PipelineDescription description(state, vertex, fragment, layout, renderPass);
+    VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo;
+    VkGraphicsPipelineCreateInfo partInfo = description.part(part, libraryInfo);
+    VkPipeline created;
+    if(vkd.vkCreateGraphicsPipelines(device, pipelineCache, 1, &partInfo, hostAllocator.callbacks(), &created) != VK_SUCCESS)
+        throw std::runtime_error("failed to create a graphics pipeline library.");
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto result = libraries.emplace(key, created);
+    if(!result.second)
+        vkd.vkDestroyPipeline(device, created, hostAllocator.callbacks());
+    else
+        libraryCompiles++;
+    return result.first->second;
+}
+
+VkPipeline PipelineRegistry::link(const VkPipeline* parts, VkPipelineLayout layout, bool optimize)
+{
+    VkPipelineLibraryCreateInfoKHR libraryInfo = {};
+    libraryInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+    libraryInfo.libraryCount = LIBRARY_PARTS;
+    libraryInfo.pLibraries = parts;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = &libraryInfo;
+    pipelineInfo.flags = optimize ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0;
+    pipelineInfo.layout = layout;
+    pipelineInfo.basePipelineIndex = -1;
+
+    VkPipeline pipeline;
+    if(vkd.vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, hostAllocator.callbacks(), &pipeline) != VK_SUCCESS)
+        throw std::runtime_error("failed to link a graphics pipeline.");
+    return pipeline;
+}
+
+VkRenderPass PipelineRegistry::compatibleRenderPass(const PipelineState& state)
+{
+    RenderPassKey key = {};
+    key.colorCount = state.colorCount;
+    for(uint32_t i = 0; i < state.colorCount; i++)
+        key.colorFormats[i] = state.colorFormats[i];
+    key.depthFormat = state.depthFormat;
+    key.samples = state.samples;
+
+    uint64_t id = hashBytes(&key, sizeof(key));
+    auto found = renderPasses.find(id);
+    if(found != renderPasses.end())
+        return found->second;
+
+    //load/store ops and layouts don't matter for compatibility, only the formats and sample counts do.
+    VkAttachmentDescription attachments[PipelineState::MAX_COLOR_TARGETS + 1] = {};
+    VkAttachmentReference colorReferences[PipelineState::MAX_COLOR_TARGETS] = {};
+    VkAttachmentReference depthReference = {};
+    uint32_t attachmentCount = 0;
+    for(uint32_t i = 0; i < state.colorCount; i++)
+    {
+        VkAttachmentDescription& attachment = attachments[attachmentCount];
+        attachment.format = state.colorFormats[i];
+        attachment.samples = state.samples;
+        attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorReferences[i].attachment = attachmentCount;
+        colorReferences[i].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        attachmentCount++;
+    }
+    if(state.depthFormat != VK_FORMAT_UNDEFINED)
+    {
+        VkAttachmentDescription& attachment = attachments[attachmentCount];
+        attachment.format = state.depthFormat;
+        attachment.samples = state.samples;
+        attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depthReference.attachment = attachmentCount;
+        depthReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        attachmentCount++;
+    }
+
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = state.colorCount;
+    subpass.pColorAttachments = colorReferences;
+    subpass.pDepthStencilAttachment = state.depthFormat != VK_FORMAT_UNDEFINED ? &depthReference : nullptr;
+
+    VkRenderPassCreateInfo renderPassInfo = {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = attachmentCount;
+    renderPassInfo.pAttachments = attachments;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+
+    VkRenderPass renderPass;
+    if(vkd.vkCreateRenderPass(device, &renderPassInfo, hostAllocator.callbacks(), &renderPass) != VK_SUCCESS)
+        throw std::runtime_error("failed to create a render pass for pipeline creation.");
+    renderPasses.emplace(id, renderPass);
+    return renderPass;
+}
+
+void PipelineRegistry::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true)
+    {
+        workAvailable.wait(lock, [this] { return stopping || !queue.empty(); });
+        //the queue is drained before stopping, destroy() means "finish what was asked for".
+        if(queue.empty())
+            return;
+
+        Task task = queue.front();
+        queue.pop_front();
+        //someone called get() on it in the meantime and compiled it themselves. optimized links are skipped once
+        //destroy() was called, the fast ones work just as well and nothing is going to draw anymore.
+        if(task.optimize && !task.entry->second.optimized && !stopping)
+            optimize(*task.entry, lock);
+        else if(!task.optimize && task.entry->second.status == QUEUED)
+            compile(*task.entry, lock);
+        else if(queue.empty())
+            compiled.notify_all();
+    }
+}
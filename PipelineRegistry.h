@@ -0,0 +1,234 @@
+#ifndef VECL_PIPELINEREGISTRY_H
+#define VECL_PIPELINEREGISTRY_H
+
+#include "VulkanDispatch.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+struct SpecializationConstant
+{
+    uint32_t id;
+    uint32_t value;
+};
+
+//everything that goes into a graphics pipeline. states are hashed and compared byte for byte, so the struct only holds
+//plain 32 and 64 bit values without padding, and slots past the counts are cleared by the registry before a lookup.
+//whatever the device can set while recording (extended dynamic state, dynamic vertex input) is also cleared before
+//the lookup, so states that only differ there share one pipeline and PipelineRegistry::setDynamicState() records it.
+struct PipelineState
+{
+    static const uint32_t MAX_SPECIALIZATION = 16;
+    static const uint32_t MAX_VERTEX_BINDINGS = 4;
+    static const uint32_t MAX_VERTEX_ATTRIBUTES = 16;
+    static const uint32_t MAX_COLOR_TARGETS = 4;
+
+    //ids from PipelineRegistry::addShader() and addLayout().
+    uint64_t vertexShader = 0;
+    uint64_t fragmentShader = 0;
+    uint64_t layout = 0;
+
+    //given to every stage, constants a shader doesn't declare are ignored.
+    uint32_t specializationCount = 0;
+    SpecializationConstant specialization[MAX_SPECIALIZATION] = {};
+
+    uint32_t vertexBindingCount = 0;
+    VkVertexInputBindingDescription vertexBindings[MAX_VERTEX_BINDINGS] = {};
+    uint32_t vertexAttributeCount = 0;
+    VkVertexInputAttributeDescription vertexAttributes[MAX_VERTEX_ATTRIBUTES] = {};
+
+    VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    VkBool32 primitiveRestart = VK_FALSE;
+    VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+    VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+    VkFrontFace frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    VkBool32 depthBias = VK_FALSE;
+    VkBool32 depthTest = VK_TRUE;
+    VkBool32 depthWrite = VK_TRUE;
+    VkCompareOp depthCompare = VK_COMPARE_OP_LESS_OR_EQUAL;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    VkBool32 alphaToCoverage = VK_FALSE;
+
+    //the formats rendered to. with dynamic rendering they go straight into the pipeline, without it the registry makes
+    //a single subpass render pass with them that every render pass with the same formats is compatible with.
+    uint32_t colorCount = 0;
+    VkFormat colorFormats[MAX_COLOR_TARGETS] = {};
+    //one per color target, the write mask starts out empty so it has to be set for anything to be written.
+    VkPipelineColorBlendAttachmentState blend[MAX_COLOR_TARGETS] = {};
+    VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+};
+
+static_assert(std::has_unique_object_representations<PipelineState>::value, "PipelineState is hashed byte for byte, it can't have padding.");
+
+//the depth bias factors for a state with depthBias set. they are dynamic state on every device and never part of the
+//pipeline (floats can't be hashed byte for byte), setDynamicState() records them. a clamp other than 0 needs the
+//depthBiasClamp feature.
+struct DepthBias
+{
+    float constant = 0.0f;
+    float clamp = 0.0f;
+    float slope = 0.0f;
+};
+
+//hands out one VkPipeline per distinct PipelineState. materials that end up with the same state share the pipeline,
+//and a state that is already being compiled (on another thread or in the background) is waited for instead of being
+//compiled a second time. all pipelines go through one VkPipelineCache. safe to use from any thread.
+//with graphics pipeline libraries a new state is fast linked from four parts (vertex input, pre-rasterization,
+//fragment shader, fragment output) that are compiled once and shared between states, and the fully optimized link
+//replaces it in the background. a material showing up mid-session then only costs the parts nothing used yet.
+class PipelineRegistry
+{
+public:
+    //"workers" threads compile what find() and prepare() queue.
+    void init(VkDevice device, uint32_t workers = 2);
+    //finishes the background compiles, then destroys the pipelines, libraries, shader modules and render passes it made.
+    //the usage is forgotten as well, saveManifest() goes first.
+    void destroy();
+
+    //creates the shader module the first time the code is seen. the id is a hash of the code, so it stays the same
+    //between runs and equal code under two names is one module.
+    uint64_t addShader(const uint32_t* code, size_t codeSize);
+    //gives a pipeline layout a name states can refer to, the registry doesn't own it.
+    uint64_t addLayout(const char* name, VkPipelineLayout layout);
+    VkPipelineLayout layout(uint64_t id) const;
+
+    //the pipeline for "state", compiled on this thread if nobody has started on it yet.
+    VkPipeline get(const PipelineState& state);
+    //binds the pipeline for "state" (see get()) and records the parts of "state" that are dynamic on this device.
+    VkPipeline bind(VkCommandBuffer commandBuffer, const PipelineState& state, const DepthBias& depthBias = DepthBias());
+    //records the parts of "state" that aren't baked into its pipeline, call it after binding a pipeline from find().
+    //"depthBias" is only recorded if the state has depth bias enabled.
+    void setDynamicState(VkCommandBuffer commandBuffer, const PipelineState& state, const DepthBias& depthBias = DepthBias()) const;
+    //the pipeline if it is ready, otherwise queues it for the background threads and returns VK_NULL_HANDLE so the
+    //caller can skip the draw or use a fallback for a frame or two.
+    VkPipeline find(const PipelineState& state);
+    //queues "state" for the background threads and returns right away (loading screens).
+    void prepare(const PipelineState& state);
+    //waits until nothing is queued or compiling anymore.
+    void waitIdle();
+
+    //reads a manifest written by saveManifest() and queues its states for the background threads in the order they were
+    //first used, so they are done before anything asks for them. call it once the shaders and layouts are added, states
+    //using one the registry doesn't know are dropped (shader ids are hashes of the code, an edited shader leaves its
+    //old states behind for good). returns how many were queued.
+    size_t warmUp(const std::string& path);
+    //writes every state get() or find() saw this session in the order of first use, followed by the ones from the
+    //warmed up manifest that weren't used this time. states with a shader or layout this session didn't add are left
+    //out. doesn't touch the file if nothing was used.
+    void saveManifest(const std::string& path) const;
+
+    size_t size() const;
+    void printReport(std::ostream& out) const;
+
+private:
+    enum Status
+    {
+        QUEUED,
+        COMPILING,
+        READY,
+        FAILED
+    };
+
+    static const uint32_t LIBRARY_PARTS = 4;
+
+    struct Entry
+    {
+        Status status = QUEUED;
+        //with pipeline libraries this is the fast linked pipeline until the optimized link replaces it.
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        //the parts it was linked from (owned by "libraries"), kept for the optimized link.
+        VkPipeline parts[LIBRARY_PARTS] = {};
+        bool optimized = false;
+        //asked for by get() or find() this session, prepare() and warm up alone don't count.
+        bool used = false;
+    };
+
+    struct StateHash
+    {
+        size_t operator()(const PipelineState& state) const;
+    };
+
+    struct StateEqual
+    {
+        bool operator()(const PipelineState& a, const PipelineState& b) const;
+    };
+
+    using PipelineMap = std::unordered_map<PipelineState, Entry, StateHash, StateEqual>;
+
+    struct Task
+    {
+        PipelineMap::value_type* entry;
+        //relink a READY entry with link time optimization instead of compiling a QUEUED one.
+        bool optimize;
+    };
+
+    //looks "state" up and adds it as QUEUED if it is new ("added"), "mutex" must be held.
+    PipelineMap::value_type& lookup(const PipelineState& state, bool& added);
+    //true if the shaders and the layout of "state" were added, "mutex" must be held.
+    bool knows(const PipelineState& state) const;
+    //records the first use of an entry for the manifest, "mutex" must be held.
+    void markUsed(PipelineMap::value_type& entry, const PipelineState& state);
+    //compiles the entry on the calling thread and wakes up everyone waiting for it, "lock" is released meanwhile.
+    void compile(PipelineMap::value_type& entry, std::unique_lock<std::mutex>& lock);
+    VkPipeline createPipeline(const PipelineState& state, VkShaderModule vertex, VkShaderModule fragment, VkPipelineLayout layout, VkRenderPass renderPass);
+    //the library for one part of "state", compiled the first time a state needs it. takes "mutex" itself.
+    VkPipeline library(VkGraphicsPipelineLibraryFlagBitsEXT part, const PipelineState& state, VkShaderModule vertex, VkShaderModule fragment, VkPipelineLayout layout, VkRenderPass renderPass);
+    VkPipeline link(const VkPipeline* parts, VkPipelineLayout layout, bool optimize);
+    //replaces the fast linked pipeline of a READY entry with the optimized link, "lock" is released meanwhile.
+    void optimize(PipelineMap::value_type& entry, std::unique_lock<std::mutex>& lock);
+    //a render pass for the state's formats, only used when there is no dynamic rendering. "mutex" must be held.
+    VkRenderPass compatibleRenderPass(const PipelineState& state);
+    void run();
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+
+    mutable std::mutex mutex;
+    //signaled when an entry leaves COMPILING and when the queue empties.
+    std::condition_variable compiled;
+    std::condition_variable workAvailable;
+    PipelineMap pipelines;
+    std::deque<Task> queue;
+    uint32_t compiling = 0;
+    bool stopping = false;
+    std::vector<std::thread> threads;
+
+    std::unordered_map<uint64_t, VkShaderModule> shaders;
+    std::unordered_map<uint64_t, VkPipelineLayout> layouts;
+    std::unordered_map<uint64_t, VkRenderPass> renderPasses;
+    //keyed by the part and the fields of the state that part is made from.
+    std::unordered_map<uint64_t, VkPipeline> libraries;
+    //fast linked pipelines an optimized link replaced, command buffers may still use them until destroy().
+    std::vector<VkPipeline> retired;
+    //the states as they were asked for, in the order of first use, and the ones warmUp() read.
+    std::vector<PipelineState> usage;
+    std::vector<PipelineState> manifest;
+
+    uint64_t hits = 0;
+    uint64_t sharedCompiles = 0;
+    uint64_t compiles = 0;
+    double compileMilliseconds = 0.0;
+    uint64_t libraryCompiles = 0;
+    uint64_t optimizedLinks = 0;
+    uint64_t warmedUp = 0;
+    //get() calls that had to compile on the calling thread, what warm up is there to bring down to zero.
+    uint64_t hotCompiles = 0;
+};
+
+//a 64 bit FNV-1a hash, the same in every run and on every platform.
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull);
+
+//the aspects of a depth/stencil format, the depth formats of states and targets may be depth only, stencil only or both.
+bool hasDepthAspect(VkFormat format);
+bool hasStencilAspect(VkFormat format);
+
+#endif //VECL_PIPELINEREGISTRY_H
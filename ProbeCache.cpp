@@ -0,0 +1,173 @@
+#include "ProbeCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+    //bump this whenever the file layout or the meaning of a probe changes, older files are then ignored.
+    const int CACHE_VERSION = 1;
+    const char* const CACHE_MAGIC = "vecl-probe-cache";
+
+    bool sameDevice(const DeviceProbe& a, const DeviceProbe& b)
+    {
+        return a.vendorID == b.vendorID && a.deviceID == b.deviceID && a.driverVersion == b.driverVersion &&
+               std::memcmp(a.uuid, b.uuid, VK_UUID_SIZE) == 0;
+    }
+
+    std::string toHex(const uint8_t* bytes, size_t count)
+    {
+        std::string hex;
+        char digits[3];
+        for(size_t i = 0; i < count; i++)
+        {
+            std::snprintf(digits, sizeof(digits), "%02x", bytes[i]);
+            hex += digits;
+        }
+        return hex;
+    }
+
+    bool fromHex(const std::string& hex, uint8_t* bytes, size_t count)
+    {
+        if(hex.size() != count * 2)
+            return false;
+        for(size_t i = 0; i < count; i++)
+        {
+            unsigned int value;
+            if(std::sscanf(hex.c_str() + i * 2, "%2x", &value) != 1)
+                return false;
+            bytes[i] = static_cast<uint8_t>(value);
+        }
+        return true;
+    }
+}
+
+void identifyDevice(VkPhysicalDevice physicalDevice, uint32_t instanceApiVersion, DeviceProbe& probe)
+{
+    VkPhysicalDeviceProperties properties;
+    vkd.vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    probe.vendorID = properties.vendorID;
+    probe.deviceID = properties.deviceID;
+    probe.driverVersion = properties.driverVersion;
+    std::memcpy(probe.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+    if(instanceApiVersion >= VK_API_VERSION_1_1 && properties.apiVersion >= VK_API_VERSION_1_1 &&
+       vkd.vkGetPhysicalDeviceProperties2 != nullptr)
+    {
+        VkPhysicalDeviceIDProperties idProperties = {};
+        idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+        VkPhysicalDeviceProperties2 properties2 = {};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &idProperties;
+
+        vkd.vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+        std::memcpy(probe.uuid, idProperties.deviceUUID, VK_UUID_SIZE);
+    }
+}
+
+void ProbeCache::load(const std::string& path)
+{
+    devices.clear();
+    validationLayers = false;
+    dirty = false;
+
+    std::ifstream file(path);
+    if(!file)
+        return;
+
+    std::string magic;
+    int version = 0;
+    if(!(file >> magic >> version) || magic != CACHE_MAGIC || version != CACHE_VERSION)
+        return;
+
+    std::string line;
+    while(std::getline(file, line))
+    {
+        std::istringstream fields(line);
+        std::string kind;
+        if(!(fields >> kind))
+            continue;
+
+        if(kind == "layers")
+        {
+            int available = 0;
+            fields >> available;
+            validationLayers = available != 0;
+        }
+        else if(kind == "device")
+        {
+            DeviceProbe probe;
+            std::string uuid;
+            int suitable = 0;
+            if(fields >> probe.vendorID >> probe.deviceID >> probe.driverVersion >> uuid >> suitable >> probe.graphicsFamily >> probe.presentFamily &&
+               fromHex(uuid, probe.uuid, VK_UUID_SIZE))
+            {
+                probe.suitable = suitable != 0;
+                devices.push_back(probe);
+            }
+        }
+    }
+}
+
+void ProbeCache::save(const std::string& path)
+{
+    if(!dirty)
+        return;
+
+    std::ofstream file(path, std::ios::trunc);
+    if(!file)
+        return;
+
+    file << CACHE_MAGIC << " " << CACHE_VERSION << "\n";
+    file << "layers " << (validationLayers ? 1 : 0) << "\n";
+    for(const DeviceProbe& probe : devices)
+    {
+        file << "device " << probe.vendorID << " " << probe.deviceID << " " << probe.driverVersion << " "
+             << toHex(probe.uuid, VK_UUID_SIZE) << " " << (probe.suitable ? 1 : 0) << " " << probe.graphicsFamily << " "
+             << probe.presentFamily << "\n";
+    }
+
+    if(file)
+        dirty = false;
+}
+
+const DeviceProbe* ProbeCache::find(const DeviceProbe& identity) const
+{
+    for(const DeviceProbe& probe : devices)
+    {
+        if(sameDevice(probe, identity))
+            return &probe;
+    }
+    return nullptr;
+}
+
+void ProbeCache::store(const DeviceProbe& probe)
+{
+    forget(probe);
+    devices.push_back(probe);
+    dirty = true;
+}
+
+void ProbeCache::forget(const DeviceProbe& identity)
+{
+    for(size_t i = 0; i < devices.size(); i++)
+    {
+        if(sameDevice(devices[i], identity))
+        {
+            devices.erase(devices.begin() + i);
+            dirty = true;
+            return;
+        }
+    }
+}
+
+void ProbeCache::setValidationLayers(bool available)
+{
+    if(validationLayers != available)
+        dirty = true;
+    validationLayers = available;
+}
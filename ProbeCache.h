@@ -0,0 +1,53 @@
+#ifndef VECL_PROBECACHE_H
+#define VECL_PROBECACHE_H
+
+#include "VulkanDispatch.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//what startup found out about one GPU, identified by its driver version and device UUID.
+struct DeviceProbe
+{
+    uint32_t vendorID = 0;
+    uint32_t deviceID = 0;
+    uint32_t driverVersion = 0;
+    uint8_t uuid[VK_UUID_SIZE] = {};
+
+    bool suitable = false;
+    uint32_t graphicsFamily = 0;
+    uint32_t presentFamily = 0;
+};
+
+//fills in the identity part of "probe" (ids, driver version, UUID). the device UUID needs Vulkan 1.1 on both the instance
+//and the device, on 1.0 the pipeline cache UUID stands in for it (it changes with the driver build as well).
+void identifyDevice(VkPhysicalDevice physicalDevice, uint32_t instanceApiVersion, DeviceProbe& probe);
+
+//remembers the results of the startup capability checks between runs, so later launches can skip enumerating queue
+//families, surface support and layers. a new driver or another GPU gives another key and the device is probed again.
+class ProbeCache
+{
+public:
+    //a missing or unreadable file just leaves the cache empty.
+    void load(const std::string& path);
+    //only writes when something changed since load().
+    void save(const std::string& path);
+
+    //nullptr if this device hasn't been probed with its current driver.
+    const DeviceProbe* find(const DeviceProbe& identity) const;
+    void store(const DeviceProbe& probe);
+    //drops everything known about the device, for when a cached answer turned out to be wrong.
+    void forget(const DeviceProbe& identity);
+
+    //true only if a previous run found the validation layers.
+    bool validationLayersKnown() const { return validationLayers; }
+    void setValidationLayers(bool available);
+
+private:
+    std::vector<DeviceProbe> devices;
+    bool validationLayers = false;
+    bool dirty = false;
+};
+
+#endif //VECL_PROBECACHE_H
@@ -0,0 +1,326 @@
+#include "QueueTimeline.h"
+
+#include "HostAllocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+    //enough fences for a few frames in flight, more are made if a queue ever gets further ahead than this.
+    const size_t INITIAL_FENCES = 4;
+}
+
+void QueueTimeline::init(VkDevice device, VkQueue queue, bool useTimelineSemaphore)
+{
+    this->device = device;
+    vkQueue = queue;
+    reserved = 0;
+    submitted = 0;
+    completed = 0;
+    broken = false;
+
+    if(useTimelineSemaphore)
+    {
+        VkSemaphoreTypeCreateInfo typeInfo = {};
+        typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        typeInfo.initialValue = 0;
+
+        VkSemaphoreCreateInfo semaphoreInfo = {};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreInfo.pNext = &typeInfo;
+
+        if(vkd.vkCreateSemaphore(device, &semaphoreInfo, hostAllocator.callbacks(), &semaphore) != VK_SUCCESS)
+            throw std::runtime_error("failed to create the queue's timeline semaphore.");
+        return;
+    }
+
+    //reserve up front so recycling fences never reallocates once the queue is running.
+    pending.reserve(INITIAL_FENCES);
+    freeFences.reserve(INITIAL_FENCES);
+    waitedFences.reserve(INITIAL_FENCES);
+    heldFences.reserve(INITIAL_FENCES);
+
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    for(size_t i = 0; i < INITIAL_FENCES; i++)
+    {
+        VkFence fence;
+        if(vkd.vkCreateFence(device, &fenceInfo, hostAllocator.callbacks(), &fence) != VK_SUCCESS)
+            throw std::runtime_error("failed to create the queue's fences.");
+        freeFences.push_back(fence);
+    }
+}
+
+void QueueTimeline::destroy()
+{
+    if(device == VK_NULL_HANDLE)
+        return;
+
+    try
+    {
+        waitIdle();
+    }
+    catch(const std::runtime_error&)
+    {
+        //the device is lost, nothing is going to finish anymore.
+    }
+
+    if(semaphore != VK_NULL_HANDLE)
+        vkd.vkDestroySemaphore(device, semaphore, hostAllocator.callbacks());
+    for(VkFence fence : freeFences)
+        vkd.vkDestroyFence(device, fence, hostAllocator.callbacks());
+    //only left over when waiting failed.
+    for(const PendingFence& entry : pending)
+        vkd.vkDestroyFence(device, entry.fence, hostAllocator.callbacks());
+
+    semaphore = VK_NULL_HANDLE;
+    pending.clear();
+    freeFences.clear();
+    waitedFences.clear();
+    heldFences.clear();
+    device = VK_NULL_HANDLE;
+}
+
+void QueueTimeline::submit(const QueueSubmission* submissions, uint32_t count)
+{
+    if(failed())
+        throw std::runtime_error("submitted to a queue timeline that failed.");
+
+    while(count > 0)
+    {
+        uint32_t batch = std::min(count, MAX_BATCH);
+
+        //everything one vkQueueSubmit needs lives on the stack, submitting never allocates.
+        VkSubmitInfo submitInfos[MAX_BATCH] = {};
+        VkTimelineSemaphoreSubmitInfo timelineInfos[MAX_BATCH] = {};
+        VkSemaphore waitSemaphores[MAX_BATCH][MAX_WAITS];
+        uint64_t waitValues[MAX_BATCH][MAX_WAITS];
+        VkPipelineStageFlags waitStages[MAX_BATCH][MAX_WAITS];
+
+        for(uint32_t i = 0; i < batch; i++)
+        {
+            const QueueSubmission& submission = submissions[i];
+            if(submission.waitCount > MAX_WAITS)
+                throw std::runtime_error("too many waits for one submit.");
+
+            VkSubmitInfo& submitInfo = submitInfos[i];
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.commandBufferCount = submission.commandBufferCount;
+            submitInfo.pCommandBuffers = submission.commandBuffers;
+
+            if(semaphore == VK_NULL_HANDLE)
+            {
+                //without timeline semaphores there is nothing the GPU could wait on, so the CPU waits for the other queues.
+                for(uint32_t j = 0; j < submission.waitCount; j++)
+                    submission.waits[j].timeline->wait(submission.waits[j].value);
+                continue;
+            }
+
+            for(uint32_t j = 0; j < submission.waitCount; j++)
+            {
+                waitSemaphores[i][j] = submission.waits[j].timeline->semaphore;
+                waitValues[i][j] = submission.waits[j].value;
+                waitStages[i][j] = submission.waits[j].stage;
+            }
+
+            VkTimelineSemaphoreSubmitInfo& timelineInfo = timelineInfos[i];
+            timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+            timelineInfo.waitSemaphoreValueCount = submission.waitCount;
+            timelineInfo.pWaitSemaphoreValues = waitValues[i];
+            timelineInfo.signalSemaphoreValueCount = 1;
+            timelineInfo.pSignalSemaphoreValues = &submission.value;
+
+            submitInfo.pNext = &timelineInfo;
+            submitInfo.waitSemaphoreCount = submission.waitCount;
+            submitInfo.pWaitSemaphores = waitSemaphores[i];
+            submitInfo.pWaitDstStageMask = waitStages[i];
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores = &semaphore;
+        }
+
+        uint64_t lastValue = submissions[batch - 1].value;
+        if(semaphore != VK_NULL_HANDLE)
+        {
+            if(vkd.vkQueueSubmit(vkQueue, batch, submitInfos, VK_NULL_HANDLE) != VK_SUCCESS)
+                throw std::runtime_error("failed to submit to the queue.");
+            std::lock_guard<std::mutex> lock(fenceMutex);
+            submitted = lastValue;
+            submittedChanged.notify_all();
+        }
+        else
+        {
+            //one fence covers the whole batch, it signals once the last submission in it is done.
+            std::lock_guard<std::mutex> lock(fenceMutex);
+            VkFence fence = takeFence();
+            if(vkd.vkQueueSubmit(vkQueue, batch, submitInfos, fence) != VK_SUCCESS)
+            {
+                freeFences.push_back(fence);
+                throw std::runtime_error("failed to submit to the queue.");
+            }
+            pending.push_back({fence, lastValue});
+            submitted = lastValue;
+            submittedChanged.notify_all();
+        }
+
+        submissions += batch;
+        count -= batch;
+    }
+}
+
+uint64_t QueueTimeline::submit(const VkCommandBuffer* commandBuffers, uint32_t commandBufferCount, const TimelineWait* waits, uint32_t waitCount)
+{
+    QueueSubmission submission = {commandBuffers, commandBufferCount, waits, waitCount, reserve()};
+    submit(&submission, 1);
+    return submission.value;
+}
+
+uint64_t QueueTimeline::completedValue() const
+{
+    if(semaphore != VK_NULL_HANDLE)
+    {
+        uint64_t value = 0;
+        vkd.vkGetSemaphoreCounterValue(device, semaphore, &value);
+        return value;
+    }
+
+    std::lock_guard<std::mutex> lock(fenceMutex);
+    retireFences(UINT64_MAX);
+    return completed;
+}
+
+void QueueTimeline::wait(uint64_t value) const
+{
+    if(value == 0)
+        return;
+
+    //a fence only exists once the submission is made, so first wait for that to happen. a timeline semaphore could be
+    //waited on right away, but a value whose submit failed would never be signaled.
+    std::unique_lock<std::mutex> lock(fenceMutex);
+    submittedChanged.wait(lock, [this, value] { return submitted >= value || broken; });
+    if(submitted < value)
+        throw std::runtime_error("waited for a queue submission that failed.");
+
+    if(semaphore != VK_NULL_HANDLE)
+    {
+        lock.unlock();
+        VkSemaphoreWaitInfo waitInfo = {};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &semaphore;
+        waitInfo.pValues = &value;
+        if(vkd.vkWaitSemaphores(device, &waitInfo, UINT64_MAX) != VK_SUCCESS)
+            throw std::runtime_error("failed to wait for the queue's timeline semaphore.");
+        return;
+    }
+
+    //the fence is waited on without the lock so submits and polls don't stall behind it, while it is listed in
+    //"waitedFences" retiring it leaves it alone instead of resetting it for reuse.
+    while(completed < value)
+    {
+        VkFence fence = pending.front().fence;
+        waitedFences.push_back(fence);
+        lock.unlock();
+        VkResult result = vkd.vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+        lock.lock();
+        releaseFence(fence);
+
+        if(result != VK_SUCCESS)
+        {
+            //the fence stays pending, nothing after it is known to have finished.
+            broken = true;
+            submittedChanged.notify_all();
+            throw std::runtime_error("failed to wait for a queue fence.");
+        }
+        retireFences(value);
+    }
+}
+
+void QueueTimeline::waitIdle() const
+{
+    uint64_t value;
+    {
+        std::lock_guard<std::mutex> lock(fenceMutex);
+        value = submitted;
+    }
+    wait(value);
+}
+
+void QueueTimeline::fail()
+{
+    {
+        std::lock_guard<std::mutex> lock(fenceMutex);
+        broken = true;
+    }
+    submittedChanged.notify_all();
+}
+
+bool QueueTimeline::failed() const
+{
+    std::lock_guard<std::mutex> lock(fenceMutex);
+    return broken;
+}
+
+VkFence QueueTimeline::takeFence()
+{
+    //fences of finished submits go back on the free list first, only when the queue is further ahead than ever a new
+    //fence gets made.
+    retireFences(UINT64_MAX);
+
+    if(freeFences.empty())
+    {
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+        VkFence fence;
+        if(vkd.vkCreateFence(device, &fenceInfo, hostAllocator.callbacks(), &fence) != VK_SUCCESS)
+            throw std::runtime_error("failed to create a queue fence.");
+        freeFences.reserve(freeFences.size() + pending.size() + heldFences.size() + 1);
+        pending.reserve(freeFences.capacity());
+        heldFences.reserve(freeFences.capacity());
+        return fence;
+    }
+
+    VkFence fence = freeFences.back();
+    freeFences.pop_back();
+    return fence;
+}
+
+void QueueTimeline::retireFences(uint64_t upTo) const
+{
+    //submits finish in order, so only the oldest pending fence ever has to be looked at.
+    size_t retired = 0;
+    while(retired < pending.size() && completed < upTo)
+    {
+        VkFence fence = pending[retired].fence;
+        if(vkd.vkGetFenceStatus(device, fence) != VK_SUCCESS)
+            break;
+
+        completed = pending[retired].value;
+        if(std::find(waitedFences.begin(), waitedFences.end(), fence) != waitedFences.end())
+            heldFences.push_back(fence);
+        else
+        {
+            vkd.vkResetFences(device, 1, &fence);
+            freeFences.push_back(fence);
+        }
+        retired++;
+    }
+    pending.erase(pending.begin(), pending.begin() + retired);
+}
+
+void QueueTimeline::releaseFence(VkFence fence) const
+{
+    waitedFences.erase(std::find(waitedFences.begin(), waitedFences.end(), fence));
+    if(std::find(waitedFences.begin(), waitedFences.end(), fence) != waitedFences.end())
+        return;
+
+    //the last waiter on a fence that got retired meanwhile recycles it.
+    auto held = std::find(heldFences.begin(), heldFences.end(), fence);
+    if(held == heldFences.end())
+        return;
+    heldFences.erase(held);
+    vkd.vkResetFences(device, 1, &fence);
+    freeFences.push_back(fence);
+}
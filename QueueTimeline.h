@@ -0,0 +1,114 @@
+#ifndef VECL_QUEUETIMELINE_H
+#define VECL_QUEUETIMELINE_H
+
+#include "VulkanDispatch.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+class QueueTimeline;
+
+//"wait until "timeline" has reached "value" before running "stage" of this submit".
+struct TimelineWait
+{
+    const QueueTimeline* timeline;
+    uint64_t value;
+    VkPipelineStageFlags stage;
+};
+
+//one VkSubmitInfo worth of work, "value" comes from QueueTimeline::reserve().
+struct QueueSubmission
+{
+    const VkCommandBuffer* commandBuffers;
+    uint32_t commandBufferCount;
+    const TimelineWait* waits;
+    uint32_t waitCount;
+    uint64_t value;
+};
+
+//tracks the progress of one queue as a single increasing counter: every submit signals the next value and anything
+//(the CPU or another queue) can wait for a value to be reached.
+//with timeline semaphores (1.2 or VK_KHR_timeline_semaphore) that is one semaphore per queue and no fences at all,
+//otherwise every vkQueueSubmit takes a fence from a small recycled set and waits from other queues happen on the CPU.
+//reserving and submitting must only happen on one thread at a time (the queue needs that anyway), waiting and
+//polling is fine from any thread, even for values that are reserved but not submitted yet.
+//once a submit or a wait fails the timeline is marked failed: values that were reserved but never submitted can't be reached
+//anymore, so waiting for one throws instead of blocking forever.
+class QueueTimeline
+{
+public:
+    //the most waits a single submission can have.
+    static constexpr uint32_t MAX_WAITS = 4;
+    //the most submissions that go into one vkQueueSubmit, bigger batches are split.
+    static constexpr uint32_t MAX_BATCH = 16;
+
+    void init(VkDevice device, VkQueue queue, bool useTimelineSemaphore);
+    //waits for everything submitted so far, then destroys the semaphore or fences. after a failed wait (the device
+    //was lost) it destroys them right away.
+    void destroy();
+
+    //hands out the value the next submission signals, submissions have to be submitted in the order they were reserved.
+    uint64_t reserve() { return ++reserved; }
+    //submits all of "submissions" with as few vkQueueSubmit calls as possible.
+    void submit(const QueueSubmission* submissions, uint32_t count);
+    //reserves a value and submits "commandBuffers" (may be none) after the waits, returns the value.
+    uint64_t submit(const VkCommandBuffer* commandBuffers, uint32_t commandBufferCount, const TimelineWait* waits = nullptr,
+                    uint32_t waitCount = 0);
+
+    //the highest value the GPU is known to have reached, doesn't block.
+    uint64_t completedValue() const;
+    bool isComplete(uint64_t value) const { return completedValue() >= value; }
+    //blocks the calling thread until "value" is reached, throws if it never will be because the timeline failed.
+    void wait(uint64_t value) const;
+    //blocks until everything that made it to the queue is done (a failed timeline doesn't throw here).
+    void waitIdle() const;
+
+    //marks the timeline failed and wakes everyone waiting on a value that wasn't submitted, called by whoever saw the
+    //submit fail. submits after that throw.
+    void fail();
+    bool failed() const;
+
+    //the value the last reserved submission will signal.
+    uint64_t lastSubmitted() const { return reserved.load(); }
+    VkQueue queue() const { return vkQueue; }
+    bool usesTimelineSemaphore() const { return semaphore != VK_NULL_HANDLE; }
+
+private:
+    struct PendingFence
+    {
+        VkFence fence;
+        uint64_t value;
+    };
+
+    //fence mode only, all are called with fenceMutex held.
+    VkFence takeFence();
+    //retires the fences that have signaled, in submission order.
+    void retireFences(uint64_t upTo) const;
+    //called by wait() once it stopped waiting on "fence", recycles it if it was retired meanwhile.
+    void releaseFence(VkFence fence) const;
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueue vkQueue = VK_NULL_HANDLE;
+    VkSemaphore semaphore = VK_NULL_HANDLE;
+    std::atomic<uint64_t> reserved{0};
+
+    //guards "submitted" and "broken", and in fence mode the fences. the bookkeeping changes when values are found
+    //complete, which is why it is mutable.
+    mutable std::mutex fenceMutex;
+    //signaled when "submitted" grows or the timeline fails, waits for values that aren't submitted yet sleep on it.
+    mutable std::condition_variable submittedChanged;
+    mutable std::vector<PendingFence> pending;
+    mutable std::vector<VkFence> freeFences;
+    //fences some thread is blocked on right now (once per thread), and the retired ones among them that can't be
+    //reset until their last waiter is done.
+    mutable std::vector<VkFence> waitedFences;
+    mutable std::vector<VkFence> heldFences;
+    mutable uint64_t completed = 0;
+    uint64_t submitted = 0;
+    mutable bool broken = false;
+};
+
+#endif //VECL_QUEUETIMELINE_H
@@ -0,0 +1,228 @@
+#include "RenderTargets.h"
+
+#include "DeletionQueue.h"
+#include "DeviceMemory.h"
+#include "HostAllocator.h"
+
+#include <algorithm>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    const VkImageUsageFlags ATTACHMENT_USAGE = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                                               VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+
+    double toMegabytes(VkDeviceSize bytes)
+    {
+        return static_cast<double>(bytes) / (1024.0 * 1024.0);
+    }
+}
+
+uint32_t RenderTargetPool::declare(const RenderTargetDesc& desc)
+{
+    Target target;
+    target.desc = desc;
+    targets.push_back(target);
+    return static_cast<uint32_t>(targets.size() - 1);
+}
+
+void RenderTargetPool::build(VkDevice device)
+{
+    for(Target& target : targets)
+    {
+        const RenderTargetDesc& desc = target.desc;
+
+        //a target that is never sampled, stored or copied never has to leave the tile memory, tell the driver so.
+        VkImageUsageFlags usage = desc.usage;
+        bool attachmentOnly = (usage & ~ATTACHMENT_USAGE) == 0;
+        if(attachmentOnly)
+            usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = desc.format;
+        imageInfo.extent = {desc.extent.width, desc.extent.height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = desc.samples;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = usage;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        if(vkd.vkCreateImage(device, &imageInfo, hostAllocator.callbacks(), &target.image) != VK_SUCCESS)
+            throw std::runtime_error(std::string("failed to create render target ") + desc.name);
+
+        vkd.vkGetImageMemoryRequirements(device, target.image, &target.requirements);
+        target.lazy = attachmentOnly && deviceMemory.findMemoryType(target.requirements.memoryTypeBits, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) >= 0;
+    }
+
+    //lazily allocated memory only gets backed if the driver really has to spill the tile, there is nothing to win by
+    //sharing it, so every lazy target gets a block of its own.
+    for(Target& target : targets)
+    {
+        if(!target.lazy)
+            continue;
+
+        Block block;
+        block.size = target.requirements.size;
+        block.alignment = target.requirements.alignment;
+        block.memoryTypeBits = target.requirements.memoryTypeBits;
+        block.lazy = true;
+        target.block = static_cast<uint32_t>(blocks.size());
+        blocks.push_back(block);
+    }
+
+    //the rest is packed greedily in order of first use: a target goes into the block that is free again by the time it
+    //starts (every earlier occupant's last pass is before its first one) and fits it best, or a new block if none is.
+    std::vector<uint32_t> order;
+    for(uint32_t i = 0; i < targets.size(); i++)
+    {
+        if(!targets[i].lazy)
+            order.push_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b)
+    {
+        return targets[a].desc.firstPass < targets[b].desc.firstPass;
+    });
+
+    for(uint32_t index : order)
+    {
+        Target& target = targets[index];
+        const VkMemoryRequirements& requirements = target.requirements;
+
+        int best = -1;
+        for(uint32_t i = 0; i < blocks.size(); i++)
+        {
+            const Block& block = blocks[i];
+            if(block.lazy || block.lastPass >= target.desc.firstPass)
+                continue;
+            if(deviceMemory.findMemoryType(block.memoryTypeBits & requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) < 0)
+                continue;
+
+            //the smallest block that already fits, otherwise the biggest one so it grows the least.
+            if(best < 0)
+                best = static_cast<int>(i);
+            else
+            {
+                const Block& current = blocks[best];
+                bool fits = block.size >= requirements.size;
+                bool currentFits = current.size >= requirements.size;
+                if(fits ? (!currentFits || block.size < current.size) : (!currentFits && block.size > current.size))
+                    best = static_cast<int>(i);
+            }
+        }
+
+        if(best < 0)
+        {
+            best = static_cast<int>(blocks.size());
+            Block block;
+            block.memoryTypeBits = requirements.memoryTypeBits;
+            blocks.push_back(block);
+        }
+
+        Block& block = blocks[best];
+        block.size = std::max(block.size, requirements.size);
+        block.alignment = std::max(block.alignment, requirements.alignment);
+        block.memoryTypeBits &= requirements.memoryTypeBits;
+        block.lastPass = std::max(block.lastPass, target.desc.lastPass);
+        target.block = static_cast<uint32_t>(best);
+    }
+
+    for(Block& block : blocks)
+    {
+        VkMemoryPropertyFlags flags = block.lazy ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        int memoryType = deviceMemory.findMemoryType(block.memoryTypeBits, flags);
+        if(memoryType < 0)
+            memoryType = deviceMemory.findMemoryType(block.memoryTypeBits, 0);
+        if(memoryType < 0)
+            throw std::runtime_error("no memory type fits the render targets.");
+
+        VkMemoryAllocateInfo allocateInfo = {};
+        allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocateInfo.allocationSize = block.size;
+        allocateInfo.memoryTypeIndex = static_cast<uint32_t>(memoryType);
+
+        if(deviceMemory.allocate(allocateInfo, MEMORY_CATEGORY_RENDER_TARGET, &block.memory) != VK_SUCCESS)
+            throw std::runtime_error("failed to allocate render target memory.");
+    }
+
+    for(Target& target : targets)
+    {
+        //every target starts at offset 0 of its block, so the block's alignment is met by the allocation itself.
+        if(vkd.vkBindImageMemory(device, target.image, blocks[target.block].memory, 0) != VK_SUCCESS)
+            throw std::runtime_error(std::string("failed to bind render target ") + target.desc.name);
+
+        VkImageViewCreateInfo viewInfo = {};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = target.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = target.desc.format;
+        viewInfo.subresourceRange.aspectMask = target.desc.aspect;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        if(vkd.vkCreateImageView(device, &viewInfo, hostAllocator.callbacks(), &target.view) != VK_SUCCESS)
+            throw std::runtime_error(std::string("failed to create the view of render target ") + target.desc.name);
+    }
+}
+
+void RenderTargetPool::retire(DeletionQueue& queue, uint64_t lastUsedFrame)
+{
+    for(const Target& target : targets)
+    {
+        if(target.view != VK_NULL_HANDLE)
+            queue.push(target.view, lastUsedFrame);
+        if(target.image != VK_NULL_HANDLE)
+            queue.push(target.image, lastUsedFrame);
+    }
+    for(const Block& block : blocks)
+    {
+        if(block.memory != VK_NULL_HANDLE)
+            queue.push(block.memory, lastUsedFrame);
+    }
+
+    targets.clear();
+    blocks.clear();
+}
+
+VkDeviceSize RenderTargetPool::allocatedBytes() const
+{
+    VkDeviceSize total = 0;
+    for(const Block& block : blocks)
+    {
+        if(!block.lazy)
+            total += block.size;
+    }
+    return total;
+}
+
+VkDeviceSize RenderTargetPool::unaliasedBytes() const
+{
+    VkDeviceSize total = 0;
+    for(const Target& target : targets)
+    {
+        if(!target.lazy)
+            total += target.requirements.size;
+    }
+    return total;
+}
+
+void RenderTargetPool::printReport(std::ostream& out) const
+{
+    out << "Render targets: " << toMegabytes(allocatedBytes()) << " MiB in " << blocks.size() << " blocks ("
+        << toMegabytes(unaliasedBytes()) << " MiB without aliasing)" << std::endl;
+    for(const Target& target : targets)
+    {
+        out << "  " << target.desc.name << ": " << toMegabytes(target.requirements.size) << " MiB, passes "
+            << target.desc.firstPass << "-" << target.desc.lastPass;
+        if(target.lazy)
+            out << ", lazily allocated";
+        else
+            out << ", block " << target.block;
+        out << std::endl;
+    }
+}
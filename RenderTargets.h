@@ -0,0 +1,83 @@
+#ifndef VECL_RENDERTARGETS_H
+#define VECL_RENDERTARGETS_H
+
+#include "VulkanDispatch.h"
+
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+class DeletionQueue;
+
+//what a render target looks like and which passes of the frame use it, passes are numbered in recording order.
+//a target is alive from its first to its last pass and its contents are undefined before the first one, the first pass
+//has to transition it from VK_IMAGE_LAYOUT_UNDEFINED (another target may have used the same memory in between).
+struct RenderTargetDesc
+{
+    const char* name;
+    VkFormat format;
+    VkExtent2D extent;
+    VkImageUsageFlags usage;
+    VkImageAspectFlags aspect;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    uint32_t firstPass = 0;
+    uint32_t lastPass = 0;
+};
+
+//creates the frame's render targets and lets the ones whose lifetimes don't overlap share memory.
+//targets that are only ever attachments get VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, and when the device has a
+//LAZILY_ALLOCATED memory type (tilers) they go there, where they usually never get any real memory at all.
+//everything else is packed into as few DEVICE_LOCAL blocks as the pass lifetimes allow.
+class RenderTargetPool
+{
+public:
+    //returns the index to look the target up with once build() ran.
+    uint32_t declare(const RenderTargetDesc& desc);
+
+    //creates the images and views for everything declared and binds their memory, throws on failure.
+    void build(VkDevice device);
+
+    //hands every image, view and memory block to the deletion queue and forgets the declarations (resize, shutdown).
+    void retire(DeletionQueue& queue, uint64_t lastUsedFrame);
+
+    VkImage image(uint32_t target) const { return targets[target].image; }
+    VkImageView view(uint32_t target) const { return targets[target].view; }
+    const RenderTargetDesc& desc(uint32_t target) const { return targets[target].desc; }
+    //true if the target lives in lazily allocated memory.
+    bool isLazy(uint32_t target) const { return targets[target].lazy; }
+
+    //bytes of device memory the targets take, and what they would have taken with a block each.
+    VkDeviceSize allocatedBytes() const;
+    VkDeviceSize unaliasedBytes() const;
+
+    void printReport(std::ostream& out) const;
+
+private:
+    struct Target
+    {
+        RenderTargetDesc desc;
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkMemoryRequirements requirements = {};
+        bool lazy = false;
+        //index into "blocks".
+        uint32_t block = 0;
+    };
+
+    //one allocation, shared by targets that are never alive at the same time.
+    struct Block
+    {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        VkDeviceSize alignment = 1;
+        uint32_t memoryTypeBits = 0;
+        //the last pass any target placed here so far is alive in.
+        uint32_t lastPass = 0;
+        bool lazy = false;
+    };
+
+    std::vector<Target> targets;
+    std::vector<Block> blocks;
+};
+
+#endif //VECL_RENDERTARGETS_H
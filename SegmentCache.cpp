@@ -0,0 +1,163 @@
+#include "SegmentCache.h"
+
+#include "DeviceFeatures.h"
+#include "HostAllocator.h"
+
+#include <ostream>
+#include <stdexcept>
+
+void SegmentCache::init(VkDevice device, uint32_t queueFamily)
+{
+    this->device = device;
+
+    //segments are re-recorded one by one, so the buffers have to be resettable on their own.
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = queueFamily;
+    if(vkd.vkCreateCommandPool(device, &poolInfo, hostAllocator.callbacks(), &pool) != VK_SUCCESS)
+        throw std::runtime_error("failed to create the segment command pool.");
+}
+
+void SegmentCache::destroy()
+{
+    //the command buffers go away with their pool.
+    if(pool != VK_NULL_HANDLE)
+        vkd.vkDestroyCommandPool(device, pool, hostAllocator.callbacks());
+    pool = VK_NULL_HANDLE;
+    segments.clear();
+    retired.clear();
+    available.clear();
+}
+
+void SegmentCache::invalidate(uint64_t segment)
+{
+    auto found = segments.find(segment);
+    if(found != segments.end())
+        found->second.valid = false;
+}
+
+void SegmentCache::invalidateAll()
+{
+    for(auto& entry : segments)
+        entry.second.valid = false;
+}
+
+void SegmentCache::remove(uint64_t segment)
+{
+    auto found = segments.find(segment);
+    if(found == segments.end())
+        return;
+    if(found->second.commandBuffer != VK_NULL_HANDLE)
+        retired.push_back({found->second.commandBuffer, found->second.lastUsedFrame});
+    segments.erase(found);
+}
+
+void SegmentCache::collect(uint64_t completedFrame)
+{
+    size_t kept = 0;
+    for(const Retired& entry : retired)
+    {
+        if(entry.lastUsedFrame <= completedFrame)
+            available.push_back(entry.commandBuffer);
+        else
+            retired[kept++] = entry;
+    }
+    retired.resize(kept);
+}
+
+void SegmentCache::printReport(std::ostream& out) const
+{
+    out << "Static segments: " << segments.size() << " cached, " << reuses << " reuses, " << recordings
+        << " recordings, " << retired.size() + available.size() << " spare command buffers" << std::endl;
+}
+
+VkCommandBuffer SegmentCache::acquire(uint64_t segment, const SegmentTarget& target, uint64_t dependencies, uint64_t frameNumber, bool& recording)
+{
+    //a different pass needs different inheritance, so it counts as a dependency as well.
+    dependencies = hashBytes(&target, sizeof(target), dependencies);
+
+    Segment& entry = segments[segment];
+    if(entry.valid && entry.dependencies == dependencies)
+    {
+        reuses++;
+        entry.lastUsedFrame = frameNumber;
+        recording = false;
+        return entry.commandBuffer;
+    }
+
+    //the old recording may still be executing in the frames in flight, it is only reset once they are done.
+    if(entry.commandBuffer != VK_NULL_HANDLE)
+        retired.push_back({entry.commandBuffer, entry.lastUsedFrame});
+    entry.commandBuffer = freeCommandBuffer();
+    entry.dependencies = dependencies;
+    entry.lastUsedFrame = frameNumber;
+    entry.valid = false;
+
+    VkCommandBufferInheritanceRenderingInfo renderingInfo = {};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+    renderingInfo.colorAttachmentCount = target.colorCount;
+    renderingInfo.pColorAttachmentFormats = target.colorFormats;
+    renderingInfo.depthAttachmentFormat = hasDepthAspect(target.depthFormat) ? target.depthFormat : VK_FORMAT_UNDEFINED;
+    renderingInfo.stencilAttachmentFormat = hasStencilAspect(target.depthFormat) ? target.depthFormat : VK_FORMAT_UNDEFINED;
+    renderingInfo.rasterizationSamples = target.samples;
+
+    VkCommandBufferInheritanceInfo inheritance = {};
+    inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance.pNext = target.renderPass == VK_NULL_HANDLE && capabilities.dynamicRendering ? &renderingInfo : nullptr;
+    inheritance.renderPass = target.renderPass;
+    inheritance.subpass = target.subpass;
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+    beginInfo.pInheritanceInfo = &inheritance;
+    if(vkd.vkBeginCommandBuffer(entry.commandBuffer, &beginInfo) != VK_SUCCESS)
+        throw std::runtime_error("failed to begin recording a static segment.");
+
+    recordings++;
+    recording = true;
+    return entry.commandBuffer;
+}
+
+void SegmentCache::finish(uint64_t segment, VkCommandBuffer commandBuffer)
+{
+    if(vkd.vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+    {
+        abandon(segment, commandBuffer);
+        throw std::runtime_error("failed to record a static segment.");
+    }
+    segments[segment].valid = true;
+}
+
+void SegmentCache::abandon(uint64_t segment, VkCommandBuffer commandBuffer)
+{
+    //never submitted, so it can be reset and reused right away. the segment is recorded from scratch next time.
+    vkd.vkResetCommandBuffer(commandBuffer, 0);
+    available.push_back(commandBuffer);
+    Segment& entry = segments[segment];
+    entry.commandBuffer = VK_NULL_HANDLE;
+    entry.valid = false;
+}
+
+VkCommandBuffer SegmentCache::freeCommandBuffer()
+{
+    //begin resets a reused buffer implicitly, the pool allows it.
+    if(!available.empty())
+    {
+        VkCommandBuffer commandBuffer = available.back();
+        available.pop_back();
+        return commandBuffer;
+    }
+
+    VkCommandBufferAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocateInfo.commandPool = pool;
+    allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    allocateInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer;
+    if(vkd.vkAllocateCommandBuffers(device, &allocateInfo, &commandBuffer) != VK_SUCCESS)
+        throw std::runtime_error("failed to allocate a static segment command buffer.");
+    return commandBuffer;
+}
@@ -0,0 +1,126 @@
+#ifndef VECL_SEGMENTCACHE_H
+#define VECL_SEGMENTCACHE_H
+
+#include "VulkanDispatch.h"
+#include "PipelineRegistry.h"
+
+#include <cstdint>
+#include <iosfwd>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+//what the commands of a segment were recorded from, as a hash. everything that would make the recorded commands
+//different goes in: pipeline handles, descriptor sets, vertex and index buffers with a version the owner bumps when
+//their contents change, the viewport. when the hash changes the segment is recorded again.
+class SegmentDependencies
+{
+public:
+    template<typename T>
+    SegmentDependencies& add(const T& value)
+    {
+        static_assert(std::has_unique_object_representations<T>::value, "dependencies are hashed byte for byte, they can't have padding.");
+        hash = hashBytes(&value, sizeof(value), hash);
+        return *this;
+    }
+
+    uint64_t value() const { return hash; }
+
+private:
+    uint64_t hash = hashBytes(nullptr, 0);
+};
+
+//the pass a segment is executed in. with dynamic rendering only the formats matter (the pass has to be begun with
+//VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT), otherwise the render pass and subpass.
+struct SegmentTarget
+{
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    uint32_t subpass = 0;
+    uint32_t colorCount = 0;
+    VkFormat colorFormats[PipelineState::MAX_COLOR_TARGETS] = {};
+    VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+};
+
+//keeps secondary command buffers for the parts of a pass that don't change between frames (static geometry) and hands
+//the same buffer out every frame until the segment's dependencies change, it is invalidated or removed. re-executing
+//a recorded buffer costs one vkCmdExecuteCommands instead of recording every draw again.
+//the buffers are recorded with SIMULTANEOUS_USE because the frames in flight all execute them. a buffer that gets
+//re-recorded is only reused once the frames that executed it are done (collect()). use it from one thread.
+class SegmentCache
+{
+public:
+    void init(VkDevice device, uint32_t queueFamily);
+    //the GPU has to be done with every segment.
+    void destroy();
+
+    //the command buffer of "segment" for the frame "frameNumber". the segment is recorded with "record(commandBuffer)"
+    //first if it is new, was invalidated or "dependencies" or "target" are not what it was recorded with.
+    //secondary command buffers don't inherit dynamic state, "record" has to set the viewport and scissor itself.
+    template<typename Record>
+    VkCommandBuffer get(uint64_t segment, const SegmentTarget& target, const SegmentDependencies& dependencies, uint64_t frameNumber, Record&& record)
+    {
+        bool recording;
+        VkCommandBuffer commandBuffer = acquire(segment, target, dependencies.value(), frameNumber, recording);
+        if(recording)
+        {
+            try
+            {
+                record(commandBuffer);
+            }
+            catch(...)
+            {
+                abandon(segment, commandBuffer);
+                throw;
+            }
+            finish(segment, commandBuffer);
+        }
+        return commandBuffer;
+    }
+
+    //records the segment again the next time it is asked for (an edit nothing in its dependencies shows).
+    void invalidate(uint64_t segment);
+    void invalidateAll();
+    //drops the segment, its command buffer is reused once "lastUsedFrame" is done.
+    void remove(uint64_t segment);
+
+    //makes the command buffers of segments that were re-recorded or removed at or before "completedFrame" reusable.
+    void collect(uint64_t completedFrame);
+
+    size_t size() const { return segments.size(); }
+    void printReport(std::ostream& out) const;
+
+private:
+    struct Segment
+    {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        uint64_t dependencies = 0;
+        uint64_t lastUsedFrame = 0;
+        bool valid = false;
+    };
+
+    struct Retired
+    {
+        VkCommandBuffer commandBuffer;
+        uint64_t lastUsedFrame;
+    };
+
+    //returns the recorded buffer, or one that has been begun for recording ("recording" is set then).
+    VkCommandBuffer acquire(uint64_t segment, const SegmentTarget& target, uint64_t dependencies, uint64_t frameNumber, bool& recording);
+    void finish(uint64_t segment, VkCommandBuffer commandBuffer);
+    //takes a buffer whose recording failed back from the segment, it is still in the recording state.
+    void abandon(uint64_t segment, VkCommandBuffer commandBuffer);
+    VkCommandBuffer freeCommandBuffer();
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkCommandPool pool = VK_NULL_HANDLE;
+    std::unordered_map<uint64_t, Segment> segments;
+    std::vector<Retired> retired;
+    std::vector<VkCommandBuffer> available;
+
+    //times a cached recording was handed out again, and times a segment had to be recorded.
+    uint64_t reuses = 0;
+    uint64_t recordings = 0;
+};
+
+#endif //VECL_SEGMENTCACHE_H
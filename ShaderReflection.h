@@ -0,0 +1,438 @@
+#ifndef VECL_SHADERREFLECTION_H
+#define VECL_SHADERREFLECTION_H
+
+#include "VulkanDispatch.h"
+#include "DescriptorTemplate.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+//everything here is constexpr: the shaders are embedded at build time (vecl_embed_shaders() in CMakeLists.txt) and
+//reflected while compiling, so startup neither reads shader files nor parses SPIR-V. the errors are thrown from
+//constant evaluation, which makes them build errors that point at the throw.
+
+struct ReflectedBinding
+{
+    uint32_t set;
+    uint32_t binding;
+    VkDescriptorType type;
+    //0 for a runtime sized array.
+    uint32_t count;
+    VkShaderStageFlags stages;
+};
+
+//what a shader (or several stages merged with mergeReflection()) expects from its pipeline layout.
+struct ShaderReflection
+{
+    static const uint32_t MAX_BINDINGS = 32;
+    static const uint32_t MAX_SPECIALIZATION = 16;
+
+    VkShaderStageFlags stages = 0;
+    ReflectedBinding bindings[MAX_BINDINGS] = {};
+    uint32_t bindingCount = 0;
+    //one range from offset 0 for all stages, 0 without push constants.
+    uint32_t pushConstantSize = 0;
+    //the constant_id of every specialization constant.
+    uint32_t specializationIds[MAX_SPECIALIZATION] = {};
+    uint32_t specializationCount = 0;
+
+    constexpr const ReflectedBinding* find(uint32_t set, uint32_t binding) const
+    {
+        for(uint32_t i = 0; i < bindingCount; i++)
+        {
+            if(bindings[i].set == set && bindings[i].binding == binding)
+                return &bindings[i];
+        }
+        return nullptr;
+    }
+
+    //fills "out" (room for MAX_BINDINGS) with the layout bindings of "set", returns how many there are.
+    constexpr uint32_t setLayoutBindings(uint32_t set, VkDescriptorSetLayoutBinding* out) const
+    {
+        uint32_t count = 0;
+        for(uint32_t i = 0; i < bindingCount; i++)
+        {
+            if(bindings[i].set != set)
+                continue;
+            out[count] = {};
+            out[count].binding = bindings[i].binding;
+            out[count].descriptorType = bindings[i].type;
+            out[count].descriptorCount = bindings[i].count;
+            out[count].stageFlags = bindings[i].stages;
+            count++;
+        }
+        return count;
+    }
+
+    constexpr bool specializes(uint32_t id) const
+    {
+        for(uint32_t i = 0; i < specializationCount; i++)
+        {
+            if(specializationIds[i] == id)
+                return true;
+        }
+        return false;
+    }
+
+    constexpr VkPushConstantRange pushConstantRange() const
+    {
+        return {stages, 0, pushConstantSize};
+    }
+};
+
+namespace spirv
+{
+    //the few parts of the SPIR-V spec reflection needs.
+    const uint32_t MAGIC = 0x07230203;
+    const size_t HEADER_WORDS = 5;
+
+    enum Op : uint32_t
+    {
+        OpEntryPoint = 15,
+        OpTypeVoid = 19,
+        OpTypeInt = 21,
+        OpTypeFloat = 22,
+        OpTypeVector = 23,
+        OpTypeMatrix = 24,
+        OpTypeImage = 25,
+        OpTypeSampler = 26,
+        OpTypeSampledImage = 27,
+        OpTypeArray = 28,
+        OpTypeRuntimeArray = 29,
+        OpTypeStruct = 30,
+        OpTypePointer = 32,
+        OpTypeForwardPointer = 39,
+        OpConstant = 43,
+        OpSpecConstant = 50,
+        OpVariable = 59,
+        OpDecorate = 71,
+        OpMemberDecorate = 72,
+        OpTypeAccelerationStructureKHR = 5341
+    };
+
+    enum Decoration : uint32_t
+    {
+        SpecId = 1,
+        Block = 2,
+        BufferBlock = 3,
+        ArrayStride = 6,
+        MatrixStride = 7,
+        Binding = 33,
+        DescriptorSet = 34,
+        Offset = 35
+    };
+
+    enum StorageClass : uint32_t
+    {
+        UniformConstant = 0,
+        Uniform = 2,
+        PushConstant = 9,
+        StorageBuffer = 12
+    };
+
+    //the dimensionalities of OpTypeImage that aren't plain images.
+    const uint32_t DIM_BUFFER = 5;
+    const uint32_t DIM_SUBPASS_DATA = 6;
+
+    constexpr uint32_t opcode(const uint32_t* instruction)
+    {
+        return instruction[0] & 0xffff;
+    }
+
+    //the id an instruction defines, 0 for the ones reflection doesn't look up.
+    constexpr uint32_t resultId(const uint32_t* instruction)
+    {
+        uint32_t op = opcode(instruction);
+        if((op >= OpTypeVoid && op < OpTypeForwardPointer) || op == OpTypeAccelerationStructureKHR)
+            return instruction[1];
+        if(op == OpConstant || op == OpSpecConstant || op == OpVariable)
+            return instruction[2];
+        return 0;
+    }
+
+    //the size of the instruction at "offset", a module that would make the walk loop or run off its end is rejected.
+    constexpr size_t instructionWords(const uint32_t* code, size_t size, size_t offset)
+    {
+        size_t words = code[offset] >> 16;
+        if(words == 0 || offset + words > size)
+            throw std::runtime_error("malformed SPIR-V module.");
+        return words;
+    }
+
+    //the instruction that defines "id".
+    constexpr const uint32_t* definition(const uint32_t* code, size_t size, uint32_t id)
+    {
+        for(size_t i = HEADER_WORDS; i < size; i += instructionWords(code, size, i))
+        {
+            if(resultId(code + i) == id)
+                return code + i;
+        }
+        throw std::runtime_error("SPIR-V id used without a definition.");
+    }
+
+    constexpr bool decoration(const uint32_t* code, size_t size, uint32_t id, Decoration kind, uint32_t& value)
+    {
+        for(size_t i = HEADER_WORDS; i < size; i += instructionWords(code, size, i))
+        {
+            if(opcode(code + i) == OpDecorate && code[i + 1] == id && code[i + 2] == kind)
+            {
+                value = (code[i] >> 16) > 3 ? code[i + 3] : 0;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    constexpr bool memberDecoration(const uint32_t* code, size_t size, uint32_t id, uint32_t member, Decoration kind, uint32_t& value)
+    {
+        for(size_t i = HEADER_WORDS; i < size; i += instructionWords(code, size, i))
+        {
+            if(opcode(code + i) == OpMemberDecorate && code[i + 1] == id && code[i + 2] == member && code[i + 3] == kind)
+            {
+                value = (code[i] >> 16) > 4 ? code[i + 4] : 0;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //the value of an integer constant, array lengths are always one.
+    constexpr uint32_t constant(const uint32_t* code, size_t size, uint32_t id)
+    {
+        const uint32_t* instruction = definition(code, size, id);
+        if(opcode(instruction) != OpConstant && opcode(instruction) != OpSpecConstant)
+            throw std::runtime_error("SPIR-V array length that isn't a constant.");
+        return instruction[3];
+    }
+
+    //the bytes a type takes up in a buffer laid out with its explicit offsets and strides. "matrixStride" comes from
+    //the struct member a matrix is in.
+    constexpr uint32_t typeSize(const uint32_t* code, size_t size, uint32_t id, uint32_t matrixStride = 0)
+    {
+        const uint32_t* type = definition(code, size, id);
+        switch(opcode(type))
+        {
+        case OpTypeInt:
+        case OpTypeFloat:
+            return type[2] / 8;
+        case OpTypeVector:
+            return type[3] * typeSize(code, size, type[2]);
+        case OpTypeMatrix:
+            return type[3] * (matrixStride != 0 ? matrixStride : typeSize(code, size, type[2]));
+        case OpTypeArray:
+        {
+            uint32_t stride = 0;
+            if(!decoration(code, size, id, ArrayStride, stride))
+                stride = typeSize(code, size, type[2], matrixStride);
+            return constant(code, size, type[3]) * stride;
+        }
+        case OpTypeStruct:
+        {
+            //the end of the member that ends last, members don't have to be in offset order.
+            uint32_t end = 0;
+            uint32_t memberCount = (type[0] >> 16) - 2;
+            for(uint32_t member = 0; member < memberCount; member++)
+            {
+                uint32_t offset = 0;
+                uint32_t stride = 0;
+                memberDecoration(code, size, id, member, Offset, offset);
+                memberDecoration(code, size, id, member, MatrixStride, stride);
+                uint32_t memberEnd = offset + typeSize(code, size, type[2 + member], stride);
+                end = memberEnd > end ? memberEnd : end;
+            }
+            return end;
+        }
+        default:
+            //runtime arrays (the tail of a storage buffer) have no size of their own.
+            return 0;
+        }
+    }
+
+    constexpr VkShaderStageFlags stageBit(uint32_t executionModel)
+    {
+        switch(executionModel)
+        {
+        case 0:
+            return VK_SHADER_STAGE_VERTEX_BIT;
+        case 1:
+            return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+        case 2:
+            return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+        case 3:
+            return VK_SHADER_STAGE_GEOMETRY_BIT;
+        case 4:
+            return VK_SHADER_STAGE_FRAGMENT_BIT;
+        case 5:
+            return VK_SHADER_STAGE_COMPUTE_BIT;
+        default:
+            throw std::runtime_error("shader stage reflection doesn't know.");
+        }
+    }
+
+    //the descriptor type of a resource variable, "type" is what it points to with the arrays already taken off.
+    constexpr VkDescriptorType descriptorType(const uint32_t* code, size_t size, uint32_t type, uint32_t storage)
+    {
+        const uint32_t* instruction = definition(code, size, type);
+        uint32_t value = 0;
+        switch(opcode(instruction))
+        {
+        case OpTypeSampler:
+            return VK_DESCRIPTOR_TYPE_SAMPLER;
+        case OpTypeSampledImage:
+            return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        case OpTypeImage:
+            //word 7 says whether the image is sampled (1) or used for loads and stores (2).
+            if(instruction[3] == DIM_SUBPASS_DATA)
+                return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+            if(instruction[3] == DIM_BUFFER)
+                return instruction[7] == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+            return instruction[7] == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        case OpTypeStruct:
+            //before SPIR-V 1.3 storage buffers are Uniform blocks decorated BufferBlock.
+            if(storage == StorageBuffer || decoration(code, size, type, BufferBlock, value))
+                return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        default:
+            throw std::runtime_error("shader resource of a type reflection doesn't know.");
+        }
+    }
+}
+
+//reads the stage, the descriptor bindings, the push constant size and the specialization constants out of a SPIR-V module.
+constexpr ShaderReflection reflectSpirv(const uint32_t* code, size_t size)
+{
+    if(size < spirv::HEADER_WORDS || code[0] != spirv::MAGIC)
+        throw std::runtime_error("not a SPIR-V module.");
+
+    ShaderReflection result;
+    for(size_t i = spirv::HEADER_WORDS; i < size; i += spirv::instructionWords(code, size, i))
+    {
+        const uint32_t* instruction = code + i;
+        if(spirv::opcode(instruction) == spirv::OpEntryPoint)
+            result.stages |= spirv::stageBit(instruction[1]);
+        if(spirv::opcode(instruction) == spirv::OpDecorate && instruction[2] == spirv::SpecId)
+        {
+            if(result.specializationCount == ShaderReflection::MAX_SPECIALIZATION)
+                throw std::runtime_error("shader with more specialization constants than ShaderReflection has room for.");
+            result.specializationIds[result.specializationCount++] = instruction[3];
+        }
+        if(spirv::opcode(instruction) != spirv::OpVariable)
+            continue;
+
+        uint32_t id = instruction[2];
+        uint32_t storage = instruction[3];
+        uint32_t pointee = spirv::definition(code, size, instruction[1])[3];
+        if(storage == spirv::PushConstant)
+        {
+            uint32_t pushSize = spirv::typeSize(code, size, pointee);
+            result.pushConstantSize = pushSize > result.pushConstantSize ? pushSize : result.pushConstantSize;
+            continue;
+        }
+        if(storage != spirv::UniformConstant && storage != spirv::Uniform && storage != spirv::StorageBuffer)
+            continue;
+
+        //acceleration structures and other resources without a binding aren't descriptors reflection handles.
+        ReflectedBinding binding = {};
+        if(!spirv::decoration(code, size, id, spirv::DescriptorSet, binding.set) || !spirv::decoration(code, size, id, spirv::Binding, binding.binding))
+            continue;
+
+        binding.count = 1;
+        const uint32_t* type = spirv::definition(code, size, pointee);
+        if(spirv::opcode(type) == spirv::OpTypeArray)
+        {
+            binding.count = spirv::constant(code, size, type[3]);
+            pointee = type[2];
+        }
+        else if(spirv::opcode(type) == spirv::OpTypeRuntimeArray)
+        {
+            binding.count = 0;
+            pointee = type[2];
+        }
+        binding.type = spirv::descriptorType(code, size, pointee, storage);
+
+        if(result.bindingCount == ShaderReflection::MAX_BINDINGS)
+            throw std::runtime_error("shader with more bindings than ShaderReflection has room for.");
+        result.bindings[result.bindingCount++] = binding;
+    }
+
+    if(result.stages == 0)
+        throw std::runtime_error("SPIR-V module without an entry point.");
+    for(uint32_t i = 0; i < result.bindingCount; i++)
+        result.bindings[i].stages = result.stages;
+    return result;
+}
+
+template<size_t N>
+constexpr ShaderReflection reflectSpirv(const uint32_t (&code)[N])
+{
+    return reflectSpirv(code, N);
+}
+
+//the layout of a pipeline made of both shaders. a binding both of them use has to be the same in each.
+constexpr ShaderReflection mergeReflection(const ShaderReflection& a, const ShaderReflection& b)
+{
+    ShaderReflection result = a;
+    result.stages |= b.stages;
+    result.pushConstantSize = a.pushConstantSize > b.pushConstantSize ? a.pushConstantSize : b.pushConstantSize;
+    for(uint32_t i = 0; i < b.bindingCount; i++)
+    {
+        const ReflectedBinding& binding = b.bindings[i];
+        ReflectedBinding* existing = nullptr;
+        for(uint32_t j = 0; j < result.bindingCount; j++)
+        {
+            if(result.bindings[j].set == binding.set && result.bindings[j].binding == binding.binding)
+                existing = &result.bindings[j];
+        }
+
+        if(existing == nullptr)
+        {
+            if(result.bindingCount == ShaderReflection::MAX_BINDINGS)
+                throw std::runtime_error("shaders with more bindings than ShaderReflection has room for.");
+            result.bindings[result.bindingCount++] = binding;
+        }
+        else if(existing->type != binding.type || existing->count != binding.count)
+            throw std::runtime_error("two shader stages disagree about a binding.");
+        else
+            existing->stages |= binding.stages;
+    }
+    for(uint32_t i = 0; i < b.specializationCount; i++)
+    {
+        if(result.specializes(b.specializationIds[i]))
+            continue;
+        if(result.specializationCount == ShaderReflection::MAX_SPECIALIZATION)
+            throw std::runtime_error("shaders with more specialization constants than ShaderReflection has room for.");
+        result.specializationIds[result.specializationCount++] = b.specializationIds[i];
+    }
+    return result;
+}
+
+//true if "entries" (the DescriptorTemplate of a set) are exactly the bindings "reflection" has in "set", with the same
+//type, count and stages. meant for a static_assert next to the struct the set is filled from.
+constexpr bool matchesTemplate(const ShaderReflection& reflection, uint32_t set, const DescriptorTemplateEntry* entries, uint32_t entryCount)
+{
+    uint32_t inSet = 0;
+    for(uint32_t i = 0; i < reflection.bindingCount; i++)
+    {
+        if(reflection.bindings[i].set == set)
+            inSet++;
+    }
+    if(inSet != entryCount)
+        return false;
+
+    for(uint32_t i = 0; i < entryCount; i++)
+    {
+        const ReflectedBinding* binding = reflection.find(set, entries[i].binding);
+        if(binding == nullptr || binding->type != entries[i].type || binding->count != entries[i].count || binding->stages != entries[i].stages)
+            return false;
+    }
+    return true;
+}
+
+template<size_t N>
+constexpr bool matchesTemplate(const ShaderReflection& reflection, uint32_t set, const DescriptorTemplateEntry (&entries)[N])
+{
+    return matchesTemplate(reflection, set, entries, static_cast<uint32_t>(N));
+}
+
+#endif //VECL_SHADERREFLECTION_H
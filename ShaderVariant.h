@@ -0,0 +1,115 @@
+#ifndef VECL_SHADERVARIANT_H
+#define VECL_SHADERVARIANT_H
+
+#include "PipelineRegistry.h"
+#include "ShaderReflection.h"
+
+#include <cstdint>
+#include <stdexcept>
+
+//one feature toggle of a shader (light count, a texture channel, a quality tier): the constant_id of the specialization
+//constant it sets and how many values it has, the values are 0 to Values - 1.
+template<uint32_t Id, uint32_t Values>
+struct VariantOption
+{
+    static_assert(Values > 0, "a variant option needs at least one value.");
+    static const uint32_t id = Id;
+    static const uint32_t values = Values;
+};
+
+//every combination of the options of one shader source, as a number. the driver compiles each variant with its
+//constants folded in, so the branches on them disappear, while there is still only the one source to maintain.
+//variants are plain pipeline states to the registry: they go through its pipeline cache, are shared, compiled in the
+//background and warmed up like any other state.
+//
+//    using MeshVariants = ShaderVariants<VariantOption<0, 2>, VariantOption<1, 3>>;
+//    constexpr uint32_t highQuality = MeshVariants::key(1, 2);
+//    pipelineRegistry.get(MeshVariants::state(baseState, highQuality));
+template<typename... Options>
+struct ShaderVariants
+{
+    static_assert(sizeof...(Options) > 0, "shader variants without options.");
+    static_assert(sizeof...(Options) <= PipelineState::MAX_SPECIALIZATION, "more variant options than a pipeline state has specialization constants.");
+
+    static constexpr uint32_t OPTIONS = sizeof...(Options);
+    //how many variants there are, keys go from 0 to COUNT - 1.
+    static constexpr uint32_t COUNT = (Options::values * ... * 1u);
+    static constexpr uint32_t ids[OPTIONS] = {Options::id...};
+    static constexpr uint32_t values[OPTIONS] = {Options::values...};
+
+    //the key of the variant with "optionValues" (one per option, in the order of the options). a value out of range
+    //is a build error when the key is constexpr and an exception otherwise.
+    template<typename... Values>
+    static constexpr uint32_t key(Values... optionValues)
+    {
+        static_assert(sizeof...(Values) == OPTIONS, "a variant key needs a value for every option.");
+        const uint32_t given[OPTIONS] = {static_cast<uint32_t>(optionValues)...};
+        uint32_t result = 0;
+        for(uint32_t i = 0; i < OPTIONS; i++)
+        {
+            if(given[i] >= values[i])
+                throw std::runtime_error("shader variant option value out of range.");
+            result = result * values[i] + given[i];
+        }
+        return result;
+    }
+
+    //the value option number "option" has in the variant "key".
+    static constexpr uint32_t value(uint32_t key, uint32_t option)
+    {
+        for(uint32_t i = OPTIONS - 1; i > option; i--)
+            key /= values[i];
+        return key % values[option];
+    }
+
+    //true if "reflection" declares a specialization constant for every option, for a static_assert next to the variants.
+    static constexpr bool declaredBy(const ShaderReflection& reflection)
+    {
+        for(uint32_t i = 0; i < OPTIONS; i++)
+        {
+            if(!reflection.specializes(ids[i]))
+                return false;
+        }
+        return true;
+    }
+
+    //"base" with the constants of the variant "key", constants "base" already has with the same ids are replaced.
+    static PipelineState state(const PipelineState& base, uint32_t key)
+    {
+        if(key >= COUNT)
+            throw std::runtime_error("shader variant key out of range.");
+
+        PipelineState result = base;
+        for(uint32_t i = 0; i < OPTIONS; i++)
+        {
+            SpecializationConstant constant = {ids[i], value(key, i)};
+            uint32_t slot = 0;
+            while(slot < result.specializationCount && result.specialization[slot].id != constant.id)
+                slot++;
+            if(slot == PipelineState::MAX_SPECIALIZATION)
+                throw std::runtime_error("too many specialization constants for a pipeline state.");
+            if(slot == result.specializationCount)
+                result.specializationCount++;
+            result.specialization[slot] = constant;
+        }
+        return result;
+    }
+
+private:
+    static constexpr bool uniqueIds()
+    {
+        for(uint32_t i = 0; i < OPTIONS; i++)
+        {
+            for(uint32_t j = i + 1; j < OPTIONS; j++)
+            {
+                if(ids[i] == ids[j])
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    static_assert(uniqueIds(), "two variant options with the same constant_id.");
+};
+
+#endif //VECL_SHADERVARIANT_H
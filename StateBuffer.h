@@ -0,0 +1,100 @@
+#ifndef VECL_STATEBUFFER_H
+#define VECL_STATEBUFFER_H
+
+#include <condition_variable>
+#include <mutex>
+
+//hands snapshots of T from a producer thread to a consumer thread through two slots, so the producer can fill in the
+//next snapshot while the consumer is still reading the current one (simulation works on frame N+1 while frame N is
+//recorded). the producer never gets more than one snapshot ahead, it blocks until the consumer picked up the last one.
+//the slots are reused, a T that keeps its capacity (vectors that are cleared, not freed) makes the handoff allocation free.
+template<typename T>
+class StateBuffer
+{
+public:
+    //the slot to fill in next, it still holds whatever was written to it two snapshots ago.
+    //blocks while the last published snapshot hasn't been picked up yet (so they are read in order), returns nullptr
+    //once the buffer is closed.
+    T* beginWrite()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        int slot = -1;
+        changed.wait(lock, [this, &slot] { return closed || (findSlot(READY) < 0 && (slot = findSlot(FREE)) >= 0); });
+        if(closed)
+            return nullptr;
+        states[slot] = WRITING;
+        return &slots[slot];
+    }
+
+    //makes the slot from beginWrite() the one the consumer gets next.
+    void publish()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            int slot = findSlot(WRITING);
+            states[slot] = READY;
+        }
+        changed.notify_all();
+    }
+
+    //waits for the next published snapshot, nothing writes to it until release(). returns nullptr once the buffer is
+    //closed and there is nothing left to read.
+    const T* acquire()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        int slot = -1;
+        changed.wait(lock, [this, &slot] { return (slot = findSlot(READY)) >= 0 || closed; });
+        if(slot < 0)
+            return nullptr;
+        states[slot] = READING;
+        return &slots[slot];
+    }
+
+    //gives the slot from acquire() back to the producer.
+    void release()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            int slot = findSlot(READING);
+            states[slot] = FREE;
+        }
+        changed.notify_all();
+    }
+
+    //wakes up both sides and makes them stop, a snapshot that was already published can still be read.
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        changed.notify_all();
+    }
+
+private:
+    enum SlotState
+    {
+        FREE,
+        WRITING,
+        READY,
+        READING
+    };
+
+    int findSlot(SlotState state) const
+    {
+        for(int i = 0; i < 2; i++)
+        {
+            if(states[i] == state)
+                return i;
+        }
+        return -1;
+    }
+
+    T slots[2];
+    SlotState states[2] = {FREE, FREE};
+    bool closed = false;
+    std::mutex mutex;
+    std::condition_variable changed;
+};
+
+#endif //VECL_STATEBUFFER_H
@@ -0,0 +1,182 @@
+#include "SubmissionThread.h"
+
+#include <stdexcept>
+
+SubmissionThread::~SubmissionThread()
+{
+    if(thread.joinable())
+    {
+        try
+        {
+            stop();
+        }
+        catch(const std::exception&)
+        {
+        }
+    }
+}
+
+void SubmissionThread::start()
+{
+    if(thread.joinable())
+        return;
+
+    stopping = false;
+    flushRequested = false;
+    failure = nullptr;
+    thread = std::thread(&SubmissionThread::run, this);
+}
+
+void SubmissionThread::stop()
+{
+    if(!thread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        flushRequested = true;
+    }
+    wakeUp.notify_one();
+    thread.join();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    rethrowFailure();
+}
+
+uint64_t SubmissionThread::enqueue(QueueTimeline& timeline, VkCommandBuffer commandBuffer, const TimelineWait* waits, uint32_t waitCount)
+{
+    if(waitCount > QueueTimeline::MAX_WAITS)
+        throw std::runtime_error("too many waits for one submit.");
+
+    Item item = {};
+    item.timeline = &timeline;
+    item.commandBuffer = commandBuffer;
+    for(uint32_t i = 0; i < waitCount; i++)
+        item.waits[i] = waits[i];
+    item.waitCount = waitCount;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    rethrowFailure();
+    //values are handed out under the same lock that orders the queue, so they reach the GPU in increasing order.
+    item.value = timeline.reserve();
+    queued.push_back(item);
+    return item.value;
+}
+
+void SubmissionThread::present(VkQueue queue, VkSwapchainKHR swapchain, uint32_t imageIndex, VkSemaphore waitSemaphore)
+{
+    Item item = {};
+    item.presentQueue = queue;
+    item.swapchain = swapchain;
+    item.imageIndex = imageIndex;
+    item.waitSemaphore = waitSemaphore;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    rethrowFailure();
+    queued.push_back(item);
+}
+
+void SubmissionThread::flush()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        rethrowFailure();
+        flushRequested = true;
+    }
+    wakeUp.notify_one();
+}
+
+void SubmissionThread::rethrowFailure()
+{
+    if(failure != nullptr)
+    {
+        std::exception_ptr error = failure;
+        failure = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void SubmissionThread::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true)
+    {
+        wakeUp.wait(lock, [this] { return flushRequested; });
+        flushRequested = false;
+        submitting.swap(queued);
+        bool last = stopping;
+
+        lock.unlock();
+        try
+        {
+            process(submitting);
+        }
+        catch(...)
+        {
+            //the queue is in an unknown state now. whoever waits on a value that never got submitted is woken up and gets
+            //an error right away, the recording side also finds out the next time it talks to us.
+            for(const Item& item : submitting)
+            {
+                if(item.timeline != nullptr)
+                    item.timeline->fail();
+            }
+            lock.lock();
+            failure = std::current_exception();
+            lock.unlock();
+        }
+        submitting.clear();
+        lock.lock();
+
+        if(last)
+            return;
+    }
+}
+
+void SubmissionThread::process(std::vector<Item>& items)
+{
+    QueueSubmission batch[QueueTimeline::MAX_BATCH];
+
+    size_t i = 0;
+    while(i < items.size())
+    {
+        Item& item = items[i];
+
+        if(item.timeline == nullptr)
+        {
+            if(vkd.vkQueuePresentKHR == nullptr)
+                throw std::runtime_error("present queued without VK_KHR_swapchain.");
+
+            VkPresentInfoKHR presentInfo = {};
+            presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+            presentInfo.waitSemaphoreCount = item.waitSemaphore != VK_NULL_HANDLE ? 1 : 0;
+            presentInfo.pWaitSemaphores = &item.waitSemaphore;
+            presentInfo.swapchainCount = 1;
+            presentInfo.pSwapchains = &item.swapchain;
+            presentInfo.pImageIndices = &item.imageIndex;
+
+            //out of date and suboptimal swapchains are the window code's business, it finds out from its next acquire.
+            VkResult result = vkd.vkQueuePresentKHR(item.presentQueue, &presentInfo);
+            if(result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR && result != VK_ERROR_OUT_OF_DATE_KHR)
+                throw std::runtime_error("failed to present.");
+            i++;
+            continue;
+        }
+
+        //everything queued in a row for the same queue goes out in one vkQueueSubmit (split at MAX_BATCH). items
+        //aren't moved past ones for other queues or presents, those may be waiting on them.
+        uint32_t count = 0;
+        while(i < items.size() && items[i].timeline == item.timeline && count < QueueTimeline::MAX_BATCH)
+        {
+            Item& next = items[i];
+            batch[count].commandBuffers = &next.commandBuffer;
+            batch[count].commandBufferCount = next.commandBuffer != VK_NULL_HANDLE ? 1 : 0;
+            batch[count].waits = next.waits;
+            batch[count].waitCount = next.waitCount;
+            batch[count].value = next.value;
+            count++;
+            i++;
+        }
+        item.timeline->submit(batch, count);
+    }
+}
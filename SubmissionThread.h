@@ -0,0 +1,70 @@
+#ifndef VECL_SUBMISSIONTHREAD_H
+#define VECL_SUBMISSIONTHREAD_H
+
+#include "QueueTimeline.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//the only thread that touches the queues once it runs. recording threads hand their command buffers over with
+//enqueue() and keep going, the thread merges everything queued for the same queue into as few vkQueueSubmit calls as
+//possible and also does the presents, in the order they were queued. since nothing else uses the queues there is no
+//need for a lock around them, even when the graphics and the present queue are the same VkQueue.
+class SubmissionThread
+{
+public:
+    ~SubmissionThread();
+
+    void start();
+    //submits whatever is still queued, then joins the thread.
+    void stop();
+
+    //queues "commandBuffer" (may be VK_NULL_HANDLE for an empty submit) for the queue of "timeline", after "waits".
+    //returns the timeline value that signals once it is done. nothing gets submitted before the next flush(), so a
+    //wait for the value from the CPU only returns after flush() was called.
+    uint64_t enqueue(QueueTimeline& timeline, VkCommandBuffer commandBuffer, const TimelineWait* waits = nullptr, uint32_t waitCount = 0);
+
+    //queues a present of "imageIndex" on "queue", it happens after everything queued before it was submitted.
+    //"waitSemaphore" is the binary semaphore the frame's last submit signals.
+    void present(VkQueue queue, VkSwapchainKHR swapchain, uint32_t imageIndex, VkSemaphore waitSemaphore);
+
+    //wakes the thread to submit what was queued so far, call it once the frame (or a batch of work) is recorded.
+    void flush();
+
+private:
+    struct Item
+    {
+        //null for presents.
+        QueueTimeline* timeline;
+        VkCommandBuffer commandBuffer;
+        TimelineWait waits[QueueTimeline::MAX_WAITS];
+        uint32_t waitCount;
+        uint64_t value;
+
+        VkQueue presentQueue;
+        VkSwapchainKHR swapchain;
+        uint32_t imageIndex;
+        VkSemaphore waitSemaphore;
+    };
+
+    void run();
+    void process(std::vector<Item>& items);
+    //rethrows a failure from the thread on the calling thread, "lock" must hold "mutex".
+    void rethrowFailure();
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    //filled by enqueue()/present(), swapped with "submitting" by the thread so neither side allocates once warmed up.
+    std::vector<Item> queued;
+    std::vector<Item> submitting;
+    bool flushRequested = false;
+    bool stopping = false;
+    std::exception_ptr failure;
+};
+
+#endif //VECL_SUBMISSIONTHREAD_H
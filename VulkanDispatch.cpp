@@ -0,0 +1,119 @@
+#include "VulkanDispatch.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+VulkanDispatch vkd;
+
+//handle of the opened loader library, null until loadVulkanLoader() succeeds.
+static void* loaderLibrary = nullptr;
+
+//the names the loader is installed under, the unversioned one only exists where the dev package is installed.
+#if defined(_WIN32)
+static const char* const loaderNames[] = {"vulkan-1.dll"};
+#elif defined(__APPLE__)
+static const char* const loaderNames[] = {"libvulkan.1.dylib", "libvulkan.dylib", "libMoltenVK.dylib"};
+#else
+static const char* const loaderNames[] = {"libvulkan.so.1", "libvulkan.so"};
+#endif
+
+static void* openLibrary(const char* name)
+{
+#if defined(_WIN32)
+    return reinterpret_cast<void*>(LoadLibraryA(name));
+#else
+    return dlopen(name, RTLD_NOW | RTLD_LOCAL);
+#endif
+}
+
+static void closeLibrary(void* library)
+{
+#if defined(_WIN32)
+    FreeLibrary(reinterpret_cast<HMODULE>(library));
+#else
+    dlclose(library);
+#endif
+}
+
+static PFN_vkGetInstanceProcAddr findGetInstanceProcAddr(void* library)
+{
+#if defined(_WIN32)
+    return reinterpret_cast<PFN_vkGetInstanceProcAddr>(GetProcAddress(reinterpret_cast<HMODULE>(library), "vkGetInstanceProcAddr"));
+#else
+    return reinterpret_cast<PFN_vkGetInstanceProcAddr>(dlsym(library, "vkGetInstanceProcAddr"));
+#endif
+}
+
+bool loadVulkanLoader()
+{
+    if(loaderLibrary != nullptr)
+        return true;
+
+    void* library = nullptr;
+    for(const char* name : loaderNames)
+    {
+        library = openLibrary(name);
+        if(library != nullptr)
+            break;
+    }
+    if(library == nullptr)
+        return false;
+
+    vkd.vkGetInstanceProcAddr = findGetInstanceProcAddr(library);
+    if(vkd.vkGetInstanceProcAddr == nullptr)
+    {
+        closeLibrary(library);
+        return false;
+    }
+
+#define VECL_LOAD_GLOBAL(name) vkd.name = (PFN_##name) vkd.vkGetInstanceProcAddr(VK_NULL_HANDLE, #name);
+    VECL_GLOBAL_FUNCTIONS(VECL_LOAD_GLOBAL)
+#undef VECL_LOAD_GLOBAL
+
+    //a loader that can't make an instance is as good as none.
+    if(vkd.vkCreateInstance == nullptr)
+    {
+        vkd = VulkanDispatch();
+        closeLibrary(library);
+        return false;
+    }
+
+    loaderLibrary = library;
+    return true;
+}
+
+void unloadVulkanLoader()
+{
+    if(loaderLibrary == nullptr)
+        return;
+
+    vkd = VulkanDispatch();
+    closeLibrary(loaderLibrary);
+    loaderLibrary = nullptr;
+}
+
+void loadInstanceFunctions(VkInstance instance)
+{
+#define VECL_LOAD_INSTANCE(name) vkd.name = (PFN_##name) vkd.vkGetInstanceProcAddr(instance, #name);
+    VECL_INSTANCE_FUNCTIONS(VECL_LOAD_INSTANCE)
+    VECL_DEVICE_FUNCTIONS(VECL_LOAD_INSTANCE)
+#undef VECL_LOAD_INSTANCE
+
+#define VECL_LOAD_INSTANCE_ALIAS(name, alias) if(vkd.name == nullptr) vkd.name = (PFN_##name) vkd.vkGetInstanceProcAddr(instance, #alias);
+    VECL_DEVICE_ALIASES(VECL_LOAD_INSTANCE_ALIAS)
+#undef VECL_LOAD_INSTANCE_ALIAS
+}
+
+void loadDeviceFunctions(VkDevice device)
+{
+#define VECL_LOAD_DEVICE(name) vkd.name = (PFN_##name) vkd.vkGetDeviceProcAddr(device, #name);
+    VECL_DEVICE_FUNCTIONS(VECL_LOAD_DEVICE)
+#undef VECL_LOAD_DEVICE
+
+#define VECL_LOAD_DEVICE_ALIAS(name, alias) if(vkd.name == nullptr) vkd.name = (PFN_##name) vkd.vkGetDeviceProcAddr(device, #alias);
+    VECL_DEVICE_ALIASES(VECL_LOAD_DEVICE_ALIAS)
+#undef VECL_LOAD_DEVICE_ALIAS
+}
@@ -0,0 +1,176 @@
+#ifndef VECL_VULKANDISPATCH_H
+#define VECL_VULKANDISPATCH_H
+
+//Vecl is compiled with VK_NO_PROTOTYPES and doesn't link against the Vulkan loader at all, the loader is opened at runtime
+//the first time loadVulkanLoader() is called, so the process starts fine on machines without Vulkan installed.
+//every Vulkan call goes through the "vkd" table: global and instance functions come from vkGetInstanceProcAddr,
+//device functions are fetched again with vkGetDeviceProcAddr once the device exists, which points them straight at the
+//driver and skips the loader's dispatch on every call.
+#ifndef VK_NO_PROTOTYPES
+#define VK_NO_PROTOTYPES
+#endif
+#include <vulkan/vulkan.h>
+
+//to call a new Vulkan function add it to the right list below, the table and the loading code are generated from these.
+
+//functions that work without an instance (vkEnumerateInstanceVersion is null on 1.0 loaders).
+#define VECL_GLOBAL_FUNCTIONS(X) \
+    X(vkCreateInstance) \
+    X(vkEnumerateInstanceExtensionProperties) \
+    X(vkEnumerateInstanceLayerProperties) \
+    X(vkEnumerateInstanceVersion)
+
+//functions that take an instance or a physical device, plus the instance extensions we use (these stay null if the
+//extension isn't enabled).
+#define VECL_INSTANCE_FUNCTIONS(X) \
+    X(vkDestroyInstance) \
+    X(vkEnumeratePhysicalDevices) \
+    X(vkGetPhysicalDeviceProperties) \
+    X(vkGetPhysicalDeviceProperties2) \
+    X(vkGetPhysicalDeviceFeatures) \
+    X(vkGetPhysicalDeviceFeatures2) \
+    X(vkGetPhysicalDeviceMemoryProperties) \
+    X(vkGetPhysicalDeviceMemoryProperties2) \
+    X(vkGetPhysicalDeviceQueueFamilyProperties) \
+    X(vkGetPhysicalDeviceFormatProperties) \
+    X(vkEnumerateDeviceExtensionProperties) \
+    X(vkCreateDevice) \
+    X(vkGetDeviceProcAddr) \
+    X(vkDestroySurfaceKHR) \
+    X(vkGetPhysicalDeviceSurfaceSupportKHR) \
+    X(vkCreateDebugUtilsMessengerEXT) \
+    X(vkDestroyDebugUtilsMessengerEXT)
+
+//functions that take a device or anything made from one, these are the hot ones.
+#define VECL_DEVICE_FUNCTIONS(X) \
+    X(vkDestroyDevice) \
+    X(vkGetDeviceQueue) \
+    X(vkDeviceWaitIdle) \
+    X(vkQueueSubmit) \
+    X(vkQueueWaitIdle) \
+    X(vkQueuePresentKHR) \
+    X(vkCreateFence) \
+    X(vkDestroyFence) \
+    X(vkWaitForFences) \
+    X(vkResetFences) \
+    X(vkGetFenceStatus) \
+    X(vkCreateSemaphore) \
+    X(vkDestroySemaphore) \
+    X(vkWaitSemaphores) \
+    X(vkGetSemaphoreCounterValue) \
+    X(vkSignalSemaphore) \
+    X(vkDestroyEvent) \
+    X(vkDestroyQueryPool) \
+    X(vkCreateBuffer) \
+    X(vkDestroyBuffer) \
+    X(vkDestroyBufferView) \
+    X(vkGetBufferMemoryRequirements) \
+    X(vkBindBufferMemory) \
+    X(vkCreateImage) \
+    X(vkDestroyImage) \
+    X(vkGetImageMemoryRequirements) \
+    X(vkBindImageMemory) \
+    X(vkCreateImageView) \
+    X(vkDestroyImageView) \
+    X(vkAllocateMemory) \
+    X(vkFreeMemory) \
+    X(vkMapMemory) \
+    X(vkUnmapMemory) \
+    X(vkDestroySampler) \
+    X(vkCreateShaderModule) \
+    X(vkDestroyShaderModule) \
+    X(vkCreateGraphicsPipelines) \
+    X(vkDestroyPipeline) \
+    X(vkCreatePipelineLayout) \
+    X(vkDestroyPipelineLayout) \
+    X(vkCreatePipelineCache) \
+    X(vkDestroyPipelineCache) \
+    X(vkCreateDescriptorSetLayout) \
+    X(vkDestroyDescriptorSetLayout) \
+    X(vkCreateDescriptorPool) \
+    X(vkDestroyDescriptorPool) \
+    X(vkResetDescriptorPool) \
+    X(vkAllocateDescriptorSets) \
+    X(vkUpdateDescriptorSets) \
+    X(vkCreateDescriptorUpdateTemplate) \
+    X(vkDestroyDescriptorUpdateTemplate) \
+    X(vkUpdateDescriptorSetWithTemplate) \
+    X(vkCreateRenderPass) \
+    X(vkDestroyRenderPass) \
+    X(vkDestroyFramebuffer) \
+    X(vkCreateCommandPool) \
+    X(vkDestroyCommandPool) \
+    X(vkResetCommandPool) \
+    X(vkAllocateCommandBuffers) \
+    X(vkFreeCommandBuffers) \
+    X(vkBeginCommandBuffer) \
+    X(vkEndCommandBuffer) \
+    X(vkResetCommandBuffer) \
+    X(vkCmdBindPipeline) \
+    X(vkCmdSetViewport) \
+    X(vkCmdSetScissor) \
+    X(vkCmdSetDepthBias) \
+    X(vkCmdSetCullMode) \
+    X(vkCmdSetFrontFace) \
+    X(vkCmdSetPrimitiveTopology) \
+    X(vkCmdSetDepthTestEnable) \
+    X(vkCmdSetDepthWriteEnable) \
+    X(vkCmdSetDepthCompareOp) \
+    X(vkCmdSetDepthBiasEnable) \
+    X(vkCmdSetPrimitiveRestartEnable) \
+    X(vkCmdSetPolygonModeEXT) \
+    X(vkCmdSetAlphaToCoverageEnableEXT) \
+    X(vkCmdSetColorBlendEnableEXT) \
+    X(vkCmdSetColorBlendEquationEXT) \
+    X(vkCmdSetColorWriteMaskEXT) \
+    X(vkCmdSetVertexInputEXT) \
+    X(vkCmdBindDescriptorSets) \
+    X(vkCmdPushConstants) \
+    X(vkCmdPushDescriptorSetWithTemplateKHR) \
+    X(vkCmdPipelineBarrier) \
+    X(vkCmdCopyBuffer) \
+    X(vkCmdFillBuffer) \
+    X(vkCmdUpdateBuffer) \
+    X(vkCmdExecuteCommands)
+
+//device functions that were promoted to core from an extension, when the core name isn't there (older API version with
+//the extension enabled) the extension's name is looked up instead. the first name must be in VECL_DEVICE_FUNCTIONS.
+#define VECL_DEVICE_ALIASES(X) \
+    X(vkWaitSemaphores, vkWaitSemaphoresKHR) \
+    X(vkGetSemaphoreCounterValue, vkGetSemaphoreCounterValueKHR) \
+    X(vkSignalSemaphore, vkSignalSemaphoreKHR) \
+    X(vkCmdSetCullMode, vkCmdSetCullModeEXT) \
+    X(vkCmdSetFrontFace, vkCmdSetFrontFaceEXT) \
+    X(vkCmdSetPrimitiveTopology, vkCmdSetPrimitiveTopologyEXT) \
+    X(vkCmdSetDepthTestEnable, vkCmdSetDepthTestEnableEXT) \
+    X(vkCmdSetDepthWriteEnable, vkCmdSetDepthWriteEnableEXT) \
+    X(vkCmdSetDepthCompareOp, vkCmdSetDepthCompareOpEXT) \
+    X(vkCmdSetDepthBiasEnable, vkCmdSetDepthBiasEnableEXT) \
+    X(vkCmdSetPrimitiveRestartEnable, vkCmdSetPrimitiveRestartEnableEXT)
+
+#define VECL_DISPATCH_MEMBER(name) PFN_##name name = nullptr;
+
+//the function pointer table, one entry per function in the lists above.
+struct VulkanDispatch
+{
+    PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr = nullptr;
+    VECL_GLOBAL_FUNCTIONS(VECL_DISPATCH_MEMBER)
+    VECL_INSTANCE_FUNCTIONS(VECL_DISPATCH_MEMBER)
+    VECL_DEVICE_FUNCTIONS(VECL_DISPATCH_MEMBER)
+};
+
+#undef VECL_DISPATCH_MEMBER
+
+extern VulkanDispatch vkd;
+
+//opens the Vulkan loader and fills in the global functions, call before anything else touches Vulkan.
+//returns false if no loader is installed, calling it again after it succeeded does nothing.
+bool loadVulkanLoader();
+//closes the loader again and clears the table, only once every instance made with it is destroyed.
+void unloadVulkanLoader();
+//fills in the instance functions, and points the device functions at the loader's trampolines until loadDeviceFunctions().
+void loadInstanceFunctions(VkInstance instance);
+//replaces the device functions with the driver's own entry points for "device".
+void loadDeviceFunctions(VkDevice device);
+
+#endif //VECL_VULKANDISPATCH_H
@@ -0,0 +1,785 @@
+//headless micro benchmarks for the Vulkan paths Vecl cares about.
+//runs without a window so it works on CI machines with lavapipe, point the loader at it with
+//VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json (or pick a device by name with VECL_BENCH_DEVICE).
+//
+//usage: vecl_bench [--out results.json] [--baseline baseline.json] [--tolerance 0.10] [--repeat N]
+//results are written as JSON, when a baseline is given every result is compared against it and the
+//process exits with 1 if anything regressed by more than the tolerance.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "VulkanDispatch.h"
+#include "FrameArena.h"
+
+struct BenchResult
+{
+    std::string name;
+    double value;
+    std::string unit;
+    bool lowerIsBetter;
+};
+
+//everything the benchmarks share, made once by createContext().
+struct BenchContext
+{
+    VkInstance instance = VK_NULL_HANDLE;
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties properties = {};
+    VkPhysicalDeviceMemoryProperties memoryProperties = {};
+    uint32_t queueFamily = 0;
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueue queue = VK_NULL_HANDLE;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+};
+
+//a buffer and the memory behind it.
+struct BenchBuffer
+{
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    void* mapped = nullptr;
+};
+
+std::vector<BenchResult> results;
+//how many times every measurement is repeated, the median is what gets reported.
+int repeatCount = 5;
+
+using Clock = std::chrono::steady_clock;
+
+double millisecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+double median(std::vector<double> samples)
+{
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+//runs "body" repeatCount times and returns the median of whatever it returned.
+template<typename Body>
+double measure(Body&& body)
+{
+    std::vector<double> samples;
+    for(int i = 0; i < repeatCount; i++)
+        samples.push_back(body());
+    return median(samples);
+}
+
+void report(const std::string& name, double value, const std::string& unit, bool lowerIsBetter)
+{
+    results.push_back({name, value, unit, lowerIsBetter});
+    std::clog << name << ": " << value << " " << unit << std::endl;
+}
+
+void check(VkResult result, const char* what)
+{
+    if(result != VK_SUCCESS)
+        throw std::runtime_error(std::string(what) + " failed with VkResult " + std::to_string(result));
+}
+
+VkInstance createHeadlessInstance()
+{
+    VkApplicationInfo appInfo = {};
+    appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    appInfo.pApplicationName = "vecl_bench";
+    appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+    appInfo.pEngineName = "Vecl";
+    appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
+    appInfo.apiVersion = VK_API_VERSION_1_0;
+
+    //no layers and no surface extensions, validation would only measure itself.
+    VkInstanceCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    createInfo.pApplicationInfo = &appInfo;
+
+    VkInstance instance;
+    check(vkd.vkCreateInstance(&createInfo, nullptr, &instance), "vkCreateInstance");
+    return instance;
+}
+
+//picks the device named in VECL_BENCH_DEVICE if set, otherwise the first one with a graphics queue.
+void pickDevice(BenchContext& context)
+{
+    uint32_t deviceCount = 0;
+    vkd.vkEnumeratePhysicalDevices(context.instance, &deviceCount, nullptr);
+    std::vector<VkPhysicalDevice> devices(deviceCount);
+    vkd.vkEnumeratePhysicalDevices(context.instance, &deviceCount, devices.data());
+
+    const char* wanted = std::getenv("VECL_BENCH_DEVICE");
+
+    for(VkPhysicalDevice candidate : devices)
+    {
+        VkPhysicalDeviceProperties properties;
+        vkd.vkGetPhysicalDeviceProperties(candidate, &properties);
+        if(wanted != nullptr && std::strstr(properties.deviceName, wanted) == nullptr)
+            continue;
+
+        uint32_t familyCount = 0;
+        vkd.vkGetPhysicalDeviceQueueFamilyProperties(candidate, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkd.vkGetPhysicalDeviceQueueFamilyProperties(candidate, &familyCount, families.data());
+
+        for(uint32_t i = 0; i < familyCount; i++)
+        {
+            if(families[i].queueCount > 0 && (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT))
+            {
+                context.physicalDevice = candidate;
+                context.properties = properties;
+                context.queueFamily = i;
+                vkd.vkGetPhysicalDeviceMemoryProperties(candidate, &context.memoryProperties);
+                return;
+            }
+        }
+    }
+
+    throw std::runtime_error("no Vulkan device with a graphics queue found (check VECL_BENCH_DEVICE / VK_ICD_FILENAMES)");
+}
+
+VkDevice createDevice(const BenchContext& context)
+{
+    float queuePriority = 1.0f;
+    VkDeviceQueueCreateInfo queueCreateInfo = {};
+    queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueCreateInfo.queueFamilyIndex = context.queueFamily;
+    queueCreateInfo.queueCount = 1;
+    queueCreateInfo.pQueuePriorities = &queuePriority;
+
+    VkPhysicalDeviceFeatures deviceFeatures = {};
+
+    VkDeviceCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.queueCreateInfoCount = 1;
+    createInfo.pQueueCreateInfos = &queueCreateInfo;
+    createInfo.pEnabledFeatures = &deviceFeatures;
+
+    VkDevice device;
+    check(vkd.vkCreateDevice(context.physicalDevice, &createInfo, nullptr, &device), "vkCreateDevice");
+    return device;
+}
+
+void createContext(BenchContext& context)
+{
+    context.instance = createHeadlessInstance();
+    loadInstanceFunctions(context.instance);
+    pickDevice(context);
+    context.device = createDevice(context);
+    //everything measured from here on calls the driver directly, the same way the app does.
+    loadDeviceFunctions(context.device);
+    vkd.vkGetDeviceQueue(context.device, context.queueFamily, 0, &context.queue);
+
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = context.queueFamily;
+    check(vkd.vkCreateCommandPool(context.device, &poolInfo, nullptr, &context.commandPool), "vkCreateCommandPool");
+
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    check(vkd.vkCreateFence(context.device, &fenceInfo, nullptr, &context.fence), "vkCreateFence");
+}
+
+void destroyContext(BenchContext& context)
+{
+    vkd.vkDeviceWaitIdle(context.device);
+    vkd.vkDestroyFence(context.device, context.fence, nullptr);
+    vkd.vkDestroyCommandPool(context.device, context.commandPool, nullptr);
+    vkd.vkDestroyDevice(context.device, nullptr);
+    vkd.vkDestroyInstance(context.instance, nullptr);
+}
+
+//returns the first memory type allowed by "typeBits" that has all of "properties", or -1.
+int findMemoryType(const BenchContext& context, uint32_t typeBits, VkMemoryPropertyFlags properties)
+{
+    for(uint32_t i = 0; i < context.memoryProperties.memoryTypeCount; i++)
+    {
+        if((typeBits & (1u << i)) && (context.memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+//makes a buffer in memory with "properties", returns false if the device has no such memory.
+bool createBuffer(const BenchContext& context, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, BenchBuffer& out)
+{
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    check(vkd.vkCreateBuffer(context.device, &bufferInfo, nullptr, &out.buffer), "vkCreateBuffer");
+
+    VkMemoryRequirements requirements;
+    vkd.vkGetBufferMemoryRequirements(context.device, out.buffer, &requirements);
+
+    int memoryType = findMemoryType(context, requirements.memoryTypeBits, properties);
+    if(memoryType < 0)
+    {
+        vkd.vkDestroyBuffer(context.device, out.buffer, nullptr);
+        out.buffer = VK_NULL_HANDLE;
+        return false;
+    }
+
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = requirements.size;
+    allocInfo.memoryTypeIndex = static_cast<uint32_t>(memoryType);
+    check(vkd.vkAllocateMemory(context.device, &allocInfo, nullptr, &out.memory), "vkAllocateMemory");
+    check(vkd.vkBindBufferMemory(context.device, out.buffer, out.memory, 0), "vkBindBufferMemory");
+
+    if(properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        check(vkd.vkMapMemory(context.device, out.memory, 0, VK_WHOLE_SIZE, 0, &out.mapped), "vkMapMemory");
+
+    return true;
+}
+
+void destroyBuffer(const BenchContext& context, BenchBuffer& buffer)
+{
+    vkd.vkDestroyBuffer(context.device, buffer.buffer, nullptr);
+    vkd.vkFreeMemory(context.device, buffer.memory, nullptr);
+    buffer = BenchBuffer();
+}
+
+VkCommandBuffer allocateCommandBuffer(const BenchContext& context, VkCommandPool pool)
+{
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = pool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer;
+    check(vkd.vkAllocateCommandBuffers(context.device, &allocInfo, &commandBuffer), "vkAllocateCommandBuffers");
+    return commandBuffer;
+}
+
+void beginOneTime(VkCommandBuffer commandBuffer)
+{
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    check(vkd.vkBeginCommandBuffer(commandBuffer, &beginInfo), "vkBeginCommandBuffer");
+}
+
+//submits one command buffer (or none) and blocks until the GPU is done with it.
+void submitAndWait(const BenchContext& context, VkCommandBuffer commandBuffer)
+{
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = commandBuffer != VK_NULL_HANDLE ? 1 : 0;
+    submitInfo.pCommandBuffers = &commandBuffer;
+
+    check(vkd.vkQueueSubmit(context.queue, 1, &submitInfo, context.fence), "vkQueueSubmit");
+    check(vkd.vkWaitForFences(context.device, 1, &context.fence, VK_TRUE, UINT64_MAX), "vkWaitForFences");
+    vkd.vkResetFences(context.device, 1, &context.fence);
+}
+
+//how long it takes to bring up and tear down an instance and a device.
+void benchCreation(const BenchContext& context)
+{
+    double instanceMs = measure([]
+    {
+        Clock::time_point start = Clock::now();
+        VkInstance instance = createHeadlessInstance();
+        double elapsed = millisecondsSince(start);
+        //the table holds the main instance's functions, get the destroy function for this one.
+        auto destroyInstance = (PFN_vkDestroyInstance) vkd.vkGetInstanceProcAddr(instance, "vkDestroyInstance");
+        destroyInstance(instance, nullptr);
+        return elapsed;
+    });
+    report("instance_create", instanceMs, "ms", true);
+
+    double deviceMs = measure([&context]
+    {
+        Clock::time_point start = Clock::now();
+        VkDevice device = createDevice(context);
+        double elapsed = millisecondsSince(start);
+        auto destroyDevice = (PFN_vkDestroyDevice) vkd.vkGetDeviceProcAddr(device, "vkDestroyDevice");
+        destroyDevice(device, nullptr);
+        return elapsed;
+    });
+    report("device_create", deviceMs, "ms", true);
+}
+
+//CPU cost of vkQueueSubmit itself, and the difference between many small submits and one batched submit.
+void benchSubmit(const BenchContext& context)
+{
+    const int submitCount = 1000;
+    const int batchSize = 64;
+
+    double emptyUs = measure([&context, submitCount]
+    {
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+        Clock::time_point start = Clock::now();
+        for(int i = 0; i < submitCount; i++)
+            vkd.vkQueueSubmit(context.queue, 1, &submitInfo, VK_NULL_HANDLE);
+        double elapsed = millisecondsSince(start);
+        vkd.vkQueueWaitIdle(context.queue);
+        return elapsed * 1000.0 / submitCount;
+    });
+    report("submit_empty", emptyUs, "us/submit", true);
+
+    double roundTripUs = measure([&context]
+    {
+        Clock::time_point start = Clock::now();
+        submitAndWait(context, VK_NULL_HANDLE);
+        return millisecondsSince(start) * 1000.0;
+    });
+    report("submit_fence_roundtrip", roundTripUs, "us", true);
+
+    //the same 64 small command buffers, submitted one vkQueueSubmit each and then all in one.
+    std::vector<VkCommandBuffer> commandBuffers(batchSize);
+    for(VkCommandBuffer& commandBuffer : commandBuffers)
+    {
+        commandBuffer = allocateCommandBuffer(context, context.commandPool);
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+        check(vkd.vkBeginCommandBuffer(commandBuffer, &beginInfo), "vkBeginCommandBuffer");
+        vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+        check(vkd.vkEndCommandBuffer(commandBuffer), "vkEndCommandBuffer");
+    }
+
+    double separateUs = measure([&context, &commandBuffers]
+    {
+        Clock::time_point start = Clock::now();
+        for(VkCommandBuffer commandBuffer : commandBuffers)
+        {
+            VkSubmitInfo submitInfo = {};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &commandBuffer;
+            vkd.vkQueueSubmit(context.queue, 1, &submitInfo, VK_NULL_HANDLE);
+        }
+        double elapsed = millisecondsSince(start);
+        vkd.vkQueueWaitIdle(context.queue);
+        return elapsed * 1000.0;
+    });
+    report("submit_64_separate", separateUs, "us", true);
+
+    double batchedUs = measure([&context, &commandBuffers]
+    {
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+        submitInfo.pCommandBuffers = commandBuffers.data();
+
+        Clock::time_point start = Clock::now();
+        vkd.vkQueueSubmit(context.queue, 1, &submitInfo, VK_NULL_HANDLE);
+        double elapsed = millisecondsSince(start);
+        vkd.vkQueueWaitIdle(context.queue);
+        return elapsed * 1000.0;
+    });
+    report("submit_64_batched", batchedUs, "us", true);
+
+    vkd.vkFreeCommandBuffers(context.device, context.commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+}
+
+//recording and executing pipeline barriers, both global memory barriers and buffer barriers.
+void benchBarriers(const BenchContext& context)
+{
+    const int barrierCount = 1000;
+
+    BenchBuffer target;
+    if(!createBuffer(context, 64 * 1024, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, target))
+    {
+        std::clog << "barriers: skipped, no matching memory type" << std::endl;
+        return;
+    }
+    VkCommandBuffer commandBuffer = allocateCommandBuffer(context, context.commandPool);
+
+    //record "barrierCount" barriers, returns how long the recording took in ms and how long execution took in "gpuMs".
+    auto run = [&](bool bufferBarriers, double& gpuMs)
+    {
+        vkd.vkResetCommandBuffer(commandBuffer, 0);
+        beginOneTime(commandBuffer);
+
+        VkMemoryBarrier memoryBarrier = {};
+        memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+        VkBufferMemoryBarrier bufferBarrier = {};
+        bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        bufferBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        bufferBarrier.buffer = target.buffer;
+        bufferBarrier.size = VK_WHOLE_SIZE;
+
+        Clock::time_point start = Clock::now();
+        for(int i = 0; i < barrierCount; i++)
+        {
+            if(bufferBarriers)
+                vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+            else
+                vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+        }
+        double recordMs = millisecondsSince(start);
+        check(vkd.vkEndCommandBuffer(commandBuffer), "vkEndCommandBuffer");
+
+        start = Clock::now();
+        submitAndWait(context, commandBuffer);
+        gpuMs = millisecondsSince(start);
+        return recordMs;
+    };
+
+    for(bool bufferBarriers : {false, true})
+    {
+        std::string name = bufferBarriers ? "barrier_buffer" : "barrier_global";
+        std::vector<double> recordSamples;
+        std::vector<double> executeSamples;
+        for(int i = 0; i < repeatCount; i++)
+        {
+            double gpuMs = 0.0;
+            recordSamples.push_back(run(bufferBarriers, gpuMs));
+            executeSamples.push_back(gpuMs);
+        }
+        report(name + "_record", median(recordSamples) * 1000.0 / barrierCount, "us/barrier", true);
+        report(name + "_execute", median(executeSamples) * 1000.0 / barrierCount, "us/barrier", true);
+    }
+
+    vkd.vkFreeCommandBuffers(context.device, context.commandPool, 1, &commandBuffer);
+    destroyBuffer(context, target);
+}
+
+//bandwidth of the different ways to get data from the CPU into a buffer the GPU reads.
+void benchUpload(const BenchContext& context)
+{
+    const VkDeviceSize uploadSize = 16 * 1024 * 1024;
+    std::vector<char> source(uploadSize);
+    for(size_t i = 0; i < source.size(); i++)
+        source[i] = static_cast<char>(i * 31);
+
+    auto toMegabytesPerSecond = [uploadSize](double ms)
+    {
+        return (static_cast<double>(uploadSize) / (1024.0 * 1024.0)) / (ms / 1000.0);
+    };
+
+    //plain memcpy into mapped memory, once into system memory and once into device local memory if the device
+    //can map it (integrated GPUs, resizable BAR).
+    struct MappedPath
+    {
+        const char* name;
+        VkMemoryPropertyFlags properties;
+    };
+    const MappedPath mappedPaths[] =
+    {
+        {"upload_host_coherent", VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT},
+        {"upload_device_local_mapped", VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT},
+    };
+
+    for(const MappedPath& path : mappedPaths)
+    {
+        BenchBuffer buffer;
+        if(!createBuffer(context, uploadSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, path.properties, buffer))
+        {
+            std::clog << path.name << ": skipped, no matching memory type" << std::endl;
+            continue;
+        }
+
+        double ms = measure([&buffer, &source]
+        {
+            Clock::time_point start = Clock::now();
+            std::memcpy(buffer.mapped, source.data(), source.size());
+            return millisecondsSince(start);
+        });
+        report(path.name, toMegabytesPerSecond(ms), "MB/s", false);
+        destroyBuffer(context, buffer);
+    }
+
+    //memcpy into a staging buffer then vkCmdCopyBuffer into device local memory, timed until the copy is done.
+    BenchBuffer staging;
+    BenchBuffer destination;
+    if(!createBuffer(context, uploadSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging) ||
+       !createBuffer(context, uploadSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, destination))
+    {
+        std::clog << "upload_staging_copy: skipped, no matching memory type" << std::endl;
+        destroyBuffer(context, staging);
+        return;
+    }
+    VkCommandBuffer commandBuffer = allocateCommandBuffer(context, context.commandPool);
+
+    double stagingMs = measure([&]
+    {
+        Clock::time_point start = Clock::now();
+        std::memcpy(staging.mapped, source.data(), source.size());
+
+        vkd.vkResetCommandBuffer(commandBuffer, 0);
+        beginOneTime(commandBuffer);
+        VkBufferCopy region = {0, 0, uploadSize};
+        vkd.vkCmdCopyBuffer(commandBuffer, staging.buffer, destination.buffer, 1, &region);
+        check(vkd.vkEndCommandBuffer(commandBuffer), "vkEndCommandBuffer");
+        submitAndWait(context, commandBuffer);
+        return millisecondsSince(start);
+    });
+    report("upload_staging_copy", toMegabytesPerSecond(stagingMs), "MB/s", false);
+
+    vkd.vkFreeCommandBuffers(context.device, context.commandPool, 1, &commandBuffer);
+    destroyBuffer(context, staging);
+    destroyBuffer(context, destination);
+}
+
+//frames per second of a frame loop shaped like the renderer's: frames in flight with a fence each, a command buffer
+//recorded every frame and the command lists built in a per frame arena. the "draws" are small buffer fills so the
+//scene doesn't need pipelines or a swapchain.
+void benchFrames(const BenchContext& context)
+{
+    const int framesInFlight = 2;
+    const int warmupFrames = 30;
+    const int measuredFrames = 300;
+
+    struct Scene
+    {
+        const char* name;
+        int drawsPerFrame;
+    };
+    const Scene scenes[] =
+    {
+        {"frame_scene_small", 100},
+        {"frame_scene_medium", 2000},
+        {"frame_scene_large", 20000},
+    };
+
+    BenchBuffer target;
+    if(!createBuffer(context, 64 * 1024, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, target))
+    {
+        std::clog << "frames: skipped, no matching memory type" << std::endl;
+        return;
+    }
+
+    VkCommandPool pools[framesInFlight];
+    VkCommandBuffer commandBuffers[framesInFlight];
+    VkFence fences[framesInFlight];
+    LinearArena arenas[framesInFlight];
+
+    for(int i = 0; i < framesInFlight; i++)
+    {
+        VkCommandPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        poolInfo.queueFamilyIndex = context.queueFamily;
+        check(vkd.vkCreateCommandPool(context.device, &poolInfo, nullptr, &pools[i]), "vkCreateCommandPool");
+        commandBuffers[i] = allocateCommandBuffer(context, pools[i]);
+
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        check(vkd.vkCreateFence(context.device, &fenceInfo, nullptr, &fences[i]), "vkCreateFence");
+    }
+
+    for(const Scene& scene : scenes)
+    {
+        auto frame = [&](int index)
+        {
+            int slot = index % framesInFlight;
+            vkd.vkWaitForFences(context.device, 1, &fences[slot], VK_TRUE, UINT64_MAX);
+            vkd.vkResetFences(context.device, 1, &fences[slot]);
+            vkd.vkResetCommandPool(context.device, pools[slot], 0);
+            arenas[slot].reset();
+
+            //build the draw list for this frame, then record it.
+            FrameVector<VkDeviceSize> drawOffsets{ArenaAllocator<VkDeviceSize>(arenas[slot])};
+            drawOffsets.reserve(scene.drawsPerFrame);
+            for(int draw = 0; draw < scene.drawsPerFrame; draw++)
+                drawOffsets.push_back(static_cast<VkDeviceSize>(draw % 1024) * 64);
+
+            beginOneTime(commandBuffers[slot]);
+            for(VkDeviceSize offset : drawOffsets)
+                vkd.vkCmdFillBuffer(commandBuffers[slot], target.buffer, offset, 64, static_cast<uint32_t>(index));
+            check(vkd.vkEndCommandBuffer(commandBuffers[slot]), "vkEndCommandBuffer");
+
+            VkSubmitInfo submitInfo = {};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &commandBuffers[slot];
+            check(vkd.vkQueueSubmit(context.queue, 1, &submitInfo, fences[slot]), "vkQueueSubmit");
+        };
+
+        for(int i = 0; i < warmupFrames; i++)
+            frame(i);
+
+        double ms = measure([&]
+        {
+            vkd.vkQueueWaitIdle(context.queue);
+            Clock::time_point start = Clock::now();
+            for(int i = 0; i < measuredFrames; i++)
+                frame(i);
+            vkd.vkQueueWaitIdle(context.queue);
+            return millisecondsSince(start);
+        });
+        report(scene.name, measuredFrames / (ms / 1000.0), "frames/s", false);
+    }
+
+    vkd.vkDeviceWaitIdle(context.device);
+    for(int i = 0; i < framesInFlight; i++)
+    {
+        vkd.vkDestroyFence(context.device, fences[i], nullptr);
+        vkd.vkDestroyCommandPool(context.device, pools[i], nullptr);
+    }
+    destroyBuffer(context, target);
+}
+
+std::string escapeJson(const std::string& text)
+{
+    std::string escaped;
+    for(char c : text)
+    {
+        if(c == '"' || c == '\\')
+            escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+std::string toJson(const BenchContext& context)
+{
+    std::ostringstream json;
+    json << "{\n";
+    json << "  \"device\": \"" << escapeJson(context.properties.deviceName) << "\",\n";
+    json << "  \"driverVersion\": " << context.properties.driverVersion << ",\n";
+    json << "  \"apiVersion\": \"" << VK_VERSION_MAJOR(context.properties.apiVersion) << "." << VK_VERSION_MINOR(context.properties.apiVersion)
+         << "." << VK_VERSION_PATCH(context.properties.apiVersion) << "\",\n";
+    json << "  \"results\": [\n";
+    for(size_t i = 0; i < results.size(); i++)
+    {
+        const BenchResult& result = results[i];
+        json << "    {\"name\": \"" << result.name << "\", \"value\": " << result.value << ", \"unit\": \"" << result.unit
+             << "\", \"better\": \"" << (result.lowerIsBetter ? "lower" : "higher") << "\"}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    json << "  ]\n}\n";
+    return json.str();
+}
+
+//reads the name/value pairs back out of a file written by toJson(), it only understands that layout.
+std::vector<std::pair<std::string, double>> readBaseline(const std::string& path)
+{
+    std::ifstream file(path);
+    if(!file)
+        throw std::runtime_error("could not open baseline " + path);
+
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string text = buffer.str();
+
+    std::vector<std::pair<std::string, double>> baseline;
+    size_t position = 0;
+    const std::string nameKey = "\"name\": \"";
+    const std::string valueKey = "\"value\": ";
+    while((position = text.find(nameKey, position)) != std::string::npos)
+    {
+        position += nameKey.size();
+        size_t nameEnd = text.find('"', position);
+        size_t valuePosition = text.find(valueKey, nameEnd);
+        if(nameEnd == std::string::npos || valuePosition == std::string::npos)
+            break;
+
+        std::string name = text.substr(position, nameEnd - position);
+        double value = std::strtod(text.c_str() + valuePosition + valueKey.size(), nullptr);
+        baseline.emplace_back(name, value);
+        position = valuePosition;
+    }
+    return baseline;
+}
+
+//returns how many results got worse than the baseline by more than "tolerance" (0.1 = 10%). a baseline case that
+//didn't run this time (skipped or renamed) counts as well, otherwise it would drop out of the comparison unnoticed.
+int compareWithBaseline(const std::string& path, double tolerance)
+{
+    int regressions = 0;
+    for(const auto& entry : readBaseline(path))
+    {
+        auto result = std::find_if(results.begin(), results.end(), [&entry](const BenchResult& r) { return r.name == entry.first; });
+        if(result == results.end())
+        {
+            regressions++;
+            std::clog << "MISSING    " << entry.first << ": in the baseline but not measured" << std::endl;
+            continue;
+        }
+        if(entry.second <= 0.0)
+            continue;
+
+        double change = (result->value - entry.second) / entry.second;
+        bool regressed = result->lowerIsBetter ? change > tolerance : -change > tolerance;
+        if(regressed)
+            regressions++;
+
+        std::clog << (regressed ? "REGRESSION " : "ok         ") << result->name << ": " << entry.second << " -> " << result->value
+                  << " " << result->unit << " (" << (change >= 0.0 ? "+" : "") << change * 100.0 << "%)" << std::endl;
+    }
+    return regressions;
+}
+
+int main(int argc, char** argv)
+{
+    std::string outPath;
+    std::string baselinePath;
+    double tolerance = 0.10;
+
+    for(int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if(argument == "--out" && i + 1 < argc)
+            outPath = argv[++i];
+        else if(argument == "--baseline" && i + 1 < argc)
+            baselinePath = argv[++i];
+        else if(argument == "--tolerance" && i + 1 < argc)
+            tolerance = std::atof(argv[++i]);
+        else if(argument == "--repeat" && i + 1 < argc)
+            repeatCount = std::max(1, std::atoi(argv[++i]));
+        else
+        {
+            std::cerr << "usage: vecl_bench [--out file] [--baseline file] [--tolerance fraction] [--repeat N]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    try
+    {
+        if(!loadVulkanLoader())
+            throw std::runtime_error("no Vulkan loader found, install one or point LD_LIBRARY_PATH at it");
+
+        BenchContext context;
+        createContext(context);
+        std::clog << "benchmarking on " << context.properties.deviceName << std::endl;
+
+        benchCreation(context);
+        benchSubmit(context);
+        benchBarriers(context);
+        benchUpload(context);
+        benchFrames(context);
+
+        std::string json = toJson(context);
+        destroyContext(context);
+        unloadVulkanLoader();
+
+        if(outPath.empty())
+            std::cout << json;
+        else
+            std::ofstream(outPath) << json;
+
+        if(!baselinePath.empty() && compareWithBaseline(baselinePath, tolerance) > 0)
+            return EXIT_FAILURE;
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,40 @@
+#turns a SPIR-V binary into a header with the code as a constexpr array and its reflection (see ShaderReflection.h).
+#run as: cmake -DSPIRV=<file.spv> -DHEADER=<file.h> -DSYMBOL=<name> -DSOURCE=<shader source> -P EmbedSpirv.cmake
+file(READ "${SPIRV}" bytes HEX)
+#glslc writes the module in little endian, the magic number tells a truncated or foreign file apart.
+string(SUBSTRING "${bytes}" 0 8 magic)
+string(LENGTH "${bytes}" length)
+math(EXPR remainder "${length} % 8")
+if(NOT magic STREQUAL "03022307" OR NOT remainder EQUAL 0)
+    message(FATAL_ERROR "${SPIRV} is not a SPIR-V module.")
+endif()
+
+#four bytes to a word, eight words to a line.
+string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1u, " words "${bytes}")
+set(word "0x[0-9a-f]+u, ")
+string(REGEX REPLACE "(${word}${word}${word}${word}${word}${word}${word}${word})" "\\1\n        " words "${words}")
+string(REPLACE " \n" "\n" words "${words}")
+string(REGEX REPLACE ",[ \n]*$" "" words "${words}")
+string(TOUPPER "${SYMBOL}" guard)
+
+file(WRITE "${HEADER}.tmp"
+"//generated from ${SOURCE} by cmake/EmbedSpirv.cmake, edit the shader instead.
+#ifndef VECL_SHADER_${guard}_H
+#define VECL_SHADER_${guard}_H
+
+#include \"ShaderReflection.h\"
+
+#include <cstdint>
+
+namespace shaders
+{
+    inline constexpr uint32_t ${SYMBOL}[] = {
+        ${words}};
+    inline constexpr ShaderReflection ${SYMBOL}_reflection = reflectSpirv(${SYMBOL});
+}
+
+#endif //VECL_SHADER_${guard}_H
+")
+#an unchanged shader keeps its header untouched, so nothing including it is rebuilt.
+execute_process(COMMAND "${CMAKE_COMMAND}" -E copy_if_different "${HEADER}.tmp" "${HEADER}")
+file(REMOVE "${HEADER}.tmp")
@@ -22,10 +22,50 @@
 
 #include<set>
 
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+//for std::min
+#include <algorithm>
+#include <cmath>
+
+#include "VulkanDispatch.h"
+#include "FrameArena.h"
+#include "DeletionQueue.h"
+#include "HostAllocator.h"
+#include "AllocationCounter.h"
+#include "DeviceMemory.h"
+#include "RenderTargets.h"
+#include "ProbeCache.h"
+#include "DeviceFeatures.h"
+#include "QueueTimeline.h"
+#include "SubmissionThread.h"
+#include "StateBuffer.h"
+#include "DescriptorAllocator.h"
+#include "BindlessHeap.h"
+#include "PipelineRegistry.h"
+#include "DescriptorTemplate.h"
+#include "SegmentCache.h"
+#include "FrameCommandPools.h"
+#include "ShaderReflection.h"
+#include "ShaderVariant.h"
+//generated while building from shaders/ (vecl_embed_shaders() in CMakeLists.txt).
+#include "shaders/mesh_vert.h"
+#include "shaders/mesh_frag.h"
+
 //window dimensions
 const int WIDTH = 800;
 const int HEIGHT = 600;
 
+//how many frames the CPU is allowed to record ahead of the GPU.
+const int MAX_FRAMES_IN_FLIGHT = 2;
+
+//simulation steps per second. there is no present to wait on yet, so this is what paces the render thread as well.
+const int SIMULATION_RATE = 60;
+
 //the validation layers we would like to use
 const std::vector<const char*> validationLayers =
         {"VK_LAYER_LUNARG_standard_validation"};
@@ -40,6 +80,8 @@ std::vector<VkImageView> swapChainImageViews;
 #endif
 
 GLFWwindow* window;
+//false when no Vulkan loader could be opened, the window still works but nothing gets rendered.
+bool vulkanAvailable = false;
 VkInstance instance;
 VkDevice device = VK_NULL_HANDLE;
 VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
@@ -47,15 +89,129 @@ VkQueue graphicsQueue;
 VkQueue presentQueue;
 VkDebugUtilsMessengerEXT debugMessenger;
 VkSurfaceKHR surface;
+//the API version the instance was created with.
+uint32_t instanceApiVersion = VK_API_VERSION_1_0;
+
+//what earlier runs found out about the layers and GPUs, so startup doesn't have to enumerate it all again.
+ProbeCache probeCache;
+std::string probeCachePath;
+
+//progress of the graphics queue, a timeline semaphore when the device has them and recycled fences otherwise.
+QueueTimeline graphicsTimeline;
+//the graphics timeline value each frame in flight slot signals when its last frame is done on the GPU.
+uint64_t slotTimelineValues[MAX_FRAMES_IN_FLIGHT] = {};
+//does every vkQueueSubmit and vkQueuePresentKHR, the render loop only hands it command buffers.
+SubmissionThread submissionThread;
+//scratch memory for each frame in flight, rewound once that frame is done on the GPU.
+LinearArena frameArenas[MAX_FRAMES_IN_FLIGHT];
+size_t currentFrame = 0;
+//how many frames have been submitted so far, frame numbers start at 1 so 0 means "not used by any frame".
+uint64_t frameNumber = 0;
+//the number of the last frame submitted in each frame in flight slot.
+uint64_t slotFrameNumbers[MAX_FRAMES_IN_FLIGHT] = {};
+//objects waiting for the frames that use them to finish before they get destroyed.
+DeletionQueue deletionQueue;
+//the frame's render targets, the ones that are never alive at the same time share memory.
+RenderTargetPool renderTargets;
+uint32_t colorTarget;
+uint32_t depthTarget;
+//every descriptor set layout, created once and shared by everything that asks for an equal one.
+DescriptorLayoutCache descriptorLayouts;
+//descriptor sets written for one frame, the slot's pools are reset once the frame is done on the GPU.
+DescriptorAllocator frameDescriptors[MAX_FRAMES_IN_FLIGHT];
+//textures, buffers and samplers by index, bound once per command buffer instead of per draw (if the device can).
+BindlessHeap bindless;
+//where the heap goes in the pipeline layouts, after the per draw set 0.
+const uint32_t BINDLESS_SET = 1;
+//every graphics pipeline, shared between all materials with the same state and compiled in the background when asked.
+PipelineRegistry pipelineRegistry;
+std::string pipelineManifestPath;
+//prints the heap budgets and the per category usage every this many frames, 0 only when a frame evicts and at exit.
+uint64_t memoryReportInterval = 0;
+//secondary command buffers for the static parts of the scene, recorded once and executed every frame after that.
+SegmentCache staticSegments;
+//the threads that record command buffers for a frame, each gets a pool of its own in every slot. only the render
+//thread records for now.
+const uint32_t RECORDING_THREADS = 1;
+const uint32_t RENDER_THREAD = 0;
+//the command buffers recorded for one frame, the slot's pools are reset once the frame is done on the GPU and the
+//buffers are recorded again instead of being freed.
+FrameCommandPools frameCommands[MAX_FRAMES_IN_FLIGHT];
+
+//set 0 of the mesh shaders, a binding added to or changed in the shaders without changing this fails the build.
+struct MeshDescriptors
+{
+    VkDescriptorBufferInfo camera;
+    VkDescriptorImageInfo albedo;
+};
 
+constexpr DescriptorTemplateEntry meshDescriptorEntries[] = {
+    VECL_DESCRIPTOR_ENTRY(MeshDescriptors, camera, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT),
+    VECL_DESCRIPTOR_ENTRY(MeshDescriptors, albedo, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)};
+constexpr ShaderReflection meshReflection = mergeReflection(shaders::mesh_vert_reflection, shaders::mesh_frag_reflection);
+static_assert(matchesTemplate(meshReflection, 0, meshDescriptorEntries), "MeshDescriptors doesn't match set 0 of the mesh shaders.");
 
-void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT debugMessenger, const VkAllocationCallbacks* pAllocator)
+//the specialization constants of shaders/mesh.frag.
+enum MeshQuality : uint32_t
+{
+    MESH_UNLIT,
+    MESH_LAMBERT,
+    MESH_WRAPPED,
+    MESH_QUALITY_COUNT
+};
+const uint32_t MESH_ALBEDO_TEXTURE_ID = 0;
+const uint32_t MESH_QUALITY_ID = 1;
+using MeshVariants = ShaderVariants<VariantOption<MESH_ALBEDO_TEXTURE_ID, 2>, VariantOption<MESH_QUALITY_ID, MESH_QUALITY_COUNT>>;
+static_assert(MeshVariants::declaredBy(meshReflection), "MeshVariants has an option the mesh shaders don't declare.");
+
+DescriptorTemplate meshDescriptors;
+VkPipelineLayout meshPipelineLayout = VK_NULL_HANDLE;
+uint64_t meshVertexShader = 0;
+uint64_t meshFragmentShader = 0;
+uint64_t meshLayout = 0;
+//the state meshes are drawn with, for the color and depth targets.
+PipelineState meshPipelineState;
+
+//input as of the last window event, written by the main thread and read by the simulation.
+struct InputState
 {
-    auto func = (PFN_vkDestroyDebugUtilsMessengerEXT) vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT");
+    double cursorX = 0.0;
+    double cursorY = 0.0;
+};
 
-    if (func != nullptr)
+//everything the renderer needs from the simulation for one frame, the render thread only ever reads a finished copy.
+struct RenderState
+{
+    //counts simulation steps, starting at 1.
+    uint64_t simulationFrame = 0;
+    //seconds since the simulation started, and since the previous step.
+    double time = 0.0;
+    double deltaTime = 0.0;
+    InputState input;
+};
+
+//main thread -> simulation thread.
+std::mutex inputMutex;
+InputState latestInput;
+//simulation thread -> render thread, the simulation fills in frame N+1 while frame N is being recorded.
+StateBuffer<RenderState> renderStates;
+//set by the render thread if drawing failed, rethrown on the main thread.
+std::exception_ptr renderFailure;
+
+//hands an object to the deletion queue, it is destroyed once the frame currently being recorded is done on the GPU.
+template<typename T>
+void retire(T handle)
+{
+    deletionQueue.push(handle, frameNumber);
+}
+
+
+void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT debugMessenger, const VkAllocationCallbacks* pAllocator)
+{
+    //the pointer is loaded with the rest of the instance functions, it is null if the extension isn't enabled.
+    if (vkd.vkDestroyDebugUtilsMessengerEXT != nullptr)
     {
-        func(instance, debugMessenger, pAllocator);
+        vkd.vkDestroyDebugUtilsMessengerEXT(instance, debugMessenger, pAllocator);
     }
 }
 
@@ -69,11 +225,9 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(VkDebugUtilsMessageSeverityF
 //this function actually creates the messenger with creation info.
 VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pDebugMessenger)
 {
-    auto func = (PFN_vkCreateDebugUtilsMessengerEXT) vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT");
-
-    if (func != nullptr)
+    if (vkd.vkCreateDebugUtilsMessengerEXT != nullptr)
     {
-        return func(instance, pCreateInfo, pAllocator, pDebugMessenger);
+        return vkd.vkCreateDebugUtilsMessengerEXT(instance, pCreateInfo, pAllocator, pDebugMessenger);
     }
     else
     {
@@ -99,7 +253,7 @@ void setupDebugMessenger()
     //doesn't have to be here.
     createInfo.pUserData = nullptr;
 
-    if (CreateDebugUtilsMessengerEXT(instance, &createInfo, nullptr, &debugMessenger) != VK_SUCCESS)
+    if (CreateDebugUtilsMessengerEXT(instance, &createInfo, hostAllocator.callbacks(), &debugMessenger) != VK_SUCCESS)
     {
         throw std::runtime_error("failed to set up debug messenger!");
     }
@@ -132,10 +286,10 @@ std::vector<const char*> getRequiredExtensions()
 bool checkValidationLayerSupport()
 {
     uint32_t layerCount;
-    vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
+    vkd.vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
 
     std::vector<VkLayerProperties> avalibleLayers(layerCount);
-    vkEnumerateInstanceLayerProperties(&layerCount, avalibleLayers.data());
+    vkd.vkEnumerateInstanceLayerProperties(&layerCount, avalibleLayers.data());
 
     //iterate through the wanted validation layers
     for(const char* layerName : validationLayers)
@@ -159,6 +313,14 @@ bool checkValidationLayerSupport()
     return true;
 }
 
+//runs on the main thread from glfwWaitEvents(), the simulation picks the position up with its next step.
+void cursorMoved(GLFWwindow*, double x, double y)
+{
+    std::lock_guard<std::mutex> lock(inputMutex);
+    latestInput.cursorX = x;
+    latestInput.cursorY = y;
+}
+
 //inits GLFW and makes a window
 void initWindow()
 {
@@ -168,14 +330,21 @@ void initWindow()
     glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
 
     window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
+    glfwSetCursorPosCallback(window, cursorMoved);
 }
 
 //creates a Vulkan instance.
 void createInstance()
 {
     //if the wanted validation layers are not found and we want to use validation layers, throw a runtime error.
-    if(enableValidationLayers && !checkValidationLayerSupport())
-        throw std::runtime_error("Requested validation layers are not available.");
+    //once a run found them they aren't enumerated again, if they got uninstalled since then instance creation says so.
+    bool layersCached = enableValidationLayers && probeCache.validationLayersKnown();
+    if(enableValidationLayers && !layersCached)
+    {
+        if(!checkValidationLayerSupport())
+            throw std::runtime_error("Requested validation layers are not available.");
+        probeCache.setValidationLayers(true);
+    }
 
     VkApplicationInfo appInfo = {};
     appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
@@ -183,7 +352,13 @@ void createInstance()
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName = "No Engine";
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    //ask for the newest version the loader has, up to 1.3. the device may still be older, DeviceNegotiator takes the
+    //lower of the two. a 1.0 loader doesn't have vkEnumerateInstanceVersion.
+    uint32_t loaderVersion = VK_API_VERSION_1_0;
+    if(vkd.vkEnumerateInstanceVersion != nullptr)
+        vkd.vkEnumerateInstanceVersion(&loaderVersion);
+    appInfo.apiVersion = std::min(loaderVersion, static_cast<uint32_t>(VK_API_VERSION_1_3));
+    instanceApiVersion = appInfo.apiVersion;
 
     VkInstanceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -203,11 +378,21 @@ void createInstance()
     createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
     createInfo.ppEnabledExtensionNames = extensions.data();
 
-    if(vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS) {
+    VkResult result = vkd.vkCreateInstance(&createInfo, hostAllocator.callbacks(), &instance);
+    if(result == VK_ERROR_LAYER_NOT_PRESENT && layersCached)
+    {
+        probeCache.setValidationLayers(false);
+        probeCache.save(probeCachePath);
+        throw std::runtime_error("Requested validation layers are not available.");
+    }
+    if(result != VK_SUCCESS) {
         throw std::runtime_error("Vulkan instance failed to create.");
     }
     else
         std::clog<<"Vulkan instance created!"<<std::endl;
+
+    //now that there is an instance, look up everything else (including the debug utils functions) once.
+    loadInstanceFunctions(instance);
 }
 
 //an index of all of the required queue families for this program.
@@ -221,6 +406,9 @@ struct QueueFamilyIndices
         return graphicsFamily.has_value() && presentFamily.has_value();
     }
 };
+//the queue families of the picked GPU, found once in pickPhysicalDevice().
+QueueFamilyIndices queueFamilyIndices;
+
 //this function checks if the GPU has all of the required queue families we need
 QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device)
 {
@@ -228,11 +416,11 @@ QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device)
 
     uint32_t queueFamilyCount = 0;
 
-    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+    vkd.vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
 
     std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
 
-    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+    vkd.vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
 
     int i = 0;
 
@@ -248,7 +436,7 @@ QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device)
             indices.graphicsFamily = i;
 
         VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+        vkd.vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
 
         if(queueFamily.queueCount > 0 && presentSupport)
             indices.presentFamily = i;
@@ -262,30 +450,68 @@ QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device)
     }
     return indices;
 }
-bool isDeviceSuitable(VkPhysicalDevice device)
+//does the full capability check of a GPU and writes the answer into "probe".
+void probeDevice(VkPhysicalDevice device, DeviceProbe& probe)
 {
     QueueFamilyIndices indices = findQueueFamilies(device);
-    return indices.isComplete();
+    probe.suitable = indices.isComplete();
+    if(probe.suitable)
+    {
+        probe.graphicsFamily = indices.graphicsFamily.value();
+        probe.presentFamily = indices.presentFamily.value();
+    }
+}
+
+//looks the GPU up in the probe cache and only probes it when there is no entry for its current driver yet.
+bool isDeviceSuitable(VkPhysicalDevice device, DeviceProbe& probe)
+{
+    identifyDevice(device, instanceApiVersion, probe);
+
+    const DeviceProbe* cached = probeCache.find(probe);
+    //a device found unsuitable may only have lacked present support for the last run's surface, so it is probed again.
+    if(cached != nullptr && !cached->suitable)
+        cached = nullptr;
+    if(cached != nullptr)
+    {
+        //the surface is new every run, one query is enough to know the cached present family can still use it.
+        VkBool32 presentSupport = VK_FALSE;
+        vkd.vkGetPhysicalDeviceSurfaceSupportKHR(device, cached->presentFamily, surface, &presentSupport);
+        if(!presentSupport)
+            cached = nullptr;
+    }
+
+    if(cached != nullptr)
+        probe = *cached;
+    else
+    {
+        probeDevice(device, probe);
+        probeCache.store(probe);
+    }
+    return probe.suitable;
 }
 
 void pickPhysicalDevice()
 {
     uint32_t deviceCount = 0;
-    vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+    vkd.vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
     if(deviceCount == 0)
         throw std::runtime_error("No GPU found with Vulkan support");
 
     std::vector<VkPhysicalDevice> devices(deviceCount);
-    vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
+    vkd.vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
 
     for(const VkPhysicalDevice &device : devices)
     {
-        if(isDeviceSuitable(device))
+        DeviceProbe probe;
+        if(isDeviceSuitable(device, probe))
         {
             physicalDevice = device;
+            queueFamilyIndices.graphicsFamily = probe.graphicsFamily;
+            queueFamilyIndices.presentFamily = probe.presentFamily;
             break;
         }
     }
+    probeCache.save(probeCachePath);
 
     if(physicalDevice == VK_NULL_HANDLE)
         throw std::runtime_error("failed to find a GPU with all of the required features need for this program");
@@ -293,7 +519,7 @@ void pickPhysicalDevice()
 
 void createLogicalDevice()
 {
-    QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+    const QueueFamilyIndices& indices = queueFamilyIndices;
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value()};
@@ -310,15 +536,16 @@ void createLogicalDevice()
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
-    VkPhysicalDeviceFeatures deviceFeatures = {};
-
     VkDeviceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
-    createInfo.pEnabledFeatures = &deviceFeatures;
 
-    createInfo.enabledExtensionCount = 0;
+    //find out which of the optional features the GPU has and switch on the ones we use, the renderer reads the result
+    //from "capabilities" to pick its paths.
+    DeviceNegotiator negotiator;
+    negotiator.negotiate(physicalDevice, instanceApiVersion);
+    negotiator.apply(createInfo);
 
     if(enableValidationLayers) {
         createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -327,18 +554,24 @@ void createLogicalDevice()
     else
         createInfo.enabledLayerCount = 0;
 
-    if(vkCreateDevice(physicalDevice, &createInfo, nullptr, &device) != VK_SUCCESS)
+    if(vkd.vkCreateDevice(physicalDevice, &createInfo, hostAllocator.callbacks(), &device) != VK_SUCCESS)
         throw std::runtime_error("Logical Device Creation Failed.");
 
-    vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
+    //swap the device functions over to the driver's entry points so command buffer calls skip the loader.
+    loadDeviceFunctions(device);
+
+    negotiator.printReport(std::clog);
+    deviceMemory.init(physicalDevice, device, capabilities.memoryBudget);
+
+    vkd.vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
 
-    vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+    vkd.vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
 
 }
 
 void createSurface()
 {
-    if(glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS)
+    if(glfwCreateWindowSurface(instance, window, hostAllocator.callbacks(), &surface) != VK_SUCCESS)
         throw std::runtime_error("GLFW failed to create the window surface.");
 
 }
@@ -348,6 +581,206 @@ void createImageViews()
 
 }
 
+//sets up the queue timelines, every slot starts at value 0 which counts as reached so the first waits return at once.
+void createSyncObjects()
+{
+    graphicsTimeline.init(device, graphicsQueue, capabilities.timelineSemaphores);
+    submissionThread.start();
+}
+
+void createDescriptorAllocators()
+{
+    descriptorLayouts.init(device);
+    for(DescriptorAllocator& allocator : frameDescriptors)
+        allocator.init(device);
+    bindless.init(device, physicalDevice, descriptorLayouts);
+}
+
+void createCommandPools()
+{
+    uint32_t graphicsFamily = queueFamilyIndices.graphicsFamily.value();
+    for(FrameCommandPools& pools : frameCommands)
+        pools.init(device, graphicsFamily, RECORDING_THREADS);
+    staticSegments.init(device, graphicsFamily);
+}
+
+//hands the embedded mesh shaders to the pipeline registry and builds their layout from the reflection.
+void createMeshPipelineLayout()
+{
+    meshVertexShader = pipelineRegistry.addShader(shaders::mesh_vert, sizeof(shaders::mesh_vert));
+    meshFragmentShader = pipelineRegistry.addShader(shaders::mesh_frag, sizeof(shaders::mesh_frag));
+
+    VkDescriptorSetLayout setLayout = meshDescriptors.init(device, descriptorLayouts, meshDescriptorEntries,
+                                                           static_cast<uint32_t>(sizeof(meshDescriptorEntries) / sizeof(meshDescriptorEntries[0])));
+    VkPushConstantRange pushConstants = meshReflection.pushConstantRange();
+    //the bindless heap comes after the per draw set, so binding it once per command buffer survives every draw.
+    VkDescriptorSetLayout setLayouts[] = {setLayout, bindless.layout()};
+
+    VkPipelineLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.setLayoutCount = bindless.available() ? BINDLESS_SET + 1 : 1;
+    layoutInfo.pSetLayouts = setLayouts;
+    layoutInfo.pushConstantRangeCount = pushConstants.size > 0 ? 1 : 0;
+    layoutInfo.pPushConstantRanges = &pushConstants;
+    if(vkd.vkCreatePipelineLayout(device, &layoutInfo, hostAllocator.callbacks(), &meshPipelineLayout) != VK_SUCCESS)
+        throw std::runtime_error("failed to create the mesh pipeline layout.");
+
+    meshDescriptors.setPipelineLayout(meshPipelineLayout, 0);
+    meshLayout = pipelineRegistry.addLayout("mesh", meshPipelineLayout);
+}
+
+//picks the first depth format from "candidates" the device can render to with optimal tiling.
+VkFormat findDepthFormat(const std::vector<VkFormat>& candidates)
+{
+    for(VkFormat format : candidates)
+    {
+        VkFormatProperties properties;
+        vkd.vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+        if(properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+            return format;
+    }
+    throw std::runtime_error("no supported depth format.");
+}
+
+//declares the render targets of the frame with the passes that use them, then lets the pool create and place them.
+void createRenderTargets()
+{
+    //what the mesh pass renders into, there is no swapchain to copy it to yet.
+    RenderTargetDesc color = {};
+    color.name = "color";
+    color.format = VK_FORMAT_R8G8B8A8_UNORM;
+    color.extent = {static_cast<uint32_t>(WIDTH), static_cast<uint32_t>(HEIGHT)};
+    color.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    color.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+    color.firstPass = 0;
+    color.lastPass = 0;
+    colorTarget = renderTargets.declare(color);
+
+    RenderTargetDesc depth = {};
+    depth.name = "depth";
+    //D16 is always supported as a depth attachment, the others are nicer to have.
+    depth.format = findDepthFormat({VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32, VK_FORMAT_D16_UNORM});
+    depth.extent = {static_cast<uint32_t>(WIDTH), static_cast<uint32_t>(HEIGHT)};
+    //only ever an attachment, so it is transient and lands in lazily allocated memory where there is some.
+    depth.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    depth.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    depth.firstPass = 0;
+    depth.lastPass = 0;
+    depthTarget = renderTargets.declare(depth);
+
+    renderTargets.build(device);
+}
+
+//interleaved position, normal and uv, as shaders/mesh.vert reads them.
+void createMeshPipelineState()
+{
+    PipelineState state;
+    state.vertexShader = meshVertexShader;
+    state.fragmentShader = meshFragmentShader;
+    state.layout = meshLayout;
+
+    state.vertexBindingCount = 1;
+    state.vertexBindings[0] = {0, 8 * sizeof(float), VK_VERTEX_INPUT_RATE_VERTEX};
+    state.vertexAttributeCount = 3;
+    state.vertexAttributes[0] = {0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0};
+    state.vertexAttributes[1] = {1, 0, VK_FORMAT_R32G32B32_SFLOAT, 3 * sizeof(float)};
+    state.vertexAttributes[2] = {2, 0, VK_FORMAT_R32G32_SFLOAT, 6 * sizeof(float)};
+
+    state.colorCount = 1;
+    state.colorFormats[0] = renderTargets.desc(colorTarget).format;
+    state.blend[0].colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    state.depthFormat = renderTargets.desc(depthTarget).format;
+
+    meshPipelineState = MeshVariants::state(state, MeshVariants::key(1, MESH_LAMBERT));
+}
+
+//the model transform of shaders/mesh.vert, column major like GLSL.
+struct MeshModel
+{
+    float columns[16];
+};
+static_assert(sizeof(MeshModel) == meshReflection.pushConstantSize, "MeshModel doesn't match the push constants of the mesh shaders.");
+
+//the meshes turn with the simulation time and tilt with the height of the cursor in the window.
+MeshModel meshModel(const RenderState& state)
+{
+    float turn = static_cast<float>(state.time);
+    float tilt = static_cast<float>((state.input.cursorY / HEIGHT - 0.5) * 1.5);
+    float cosTurn = std::cos(turn);
+    float sinTurn = std::sin(turn);
+    float cosTilt = std::cos(tilt);
+    float sinTilt = std::sin(tilt);
+
+    //a rotation around y times a rotation around x.
+    return {{cosTurn, 0.0f, -sinTurn, 0.0f,
+             sinTurn * sinTilt, cosTilt, cosTurn * sinTilt, 0.0f,
+             sinTurn * cosTilt, -sinTilt, cosTurn * cosTilt, 0.0f,
+             0.0f, 0.0f, 0.0f, 1.0f}};
+}
+
+//records frame N from the simulation's snapshot "state", nothing else the simulation touches is read.
+void drawFrame(const RenderState& state)
+{
+    //wait until the GPU is done with the last frame that used this slot, after that nothing it was given is in use anymore.
+    graphicsTimeline.wait(slotTimelineValues[currentFrame]);
+
+    //frames finish in submission order, so every frame up to the one that last used this slot is done now.
+    deletionQueue.collect(device, slotFrameNumbers[currentFrame]);
+    bindless.collect(slotFrameNumbers[currentFrame]);
+    staticSegments.collect(slotFrameNumbers[currentFrame]);
+    //see how close each heap is to its budget and drop streamed resources before the driver starts paging.
+    deviceMemory.updateBudget();
+    VkDeviceSize evicted = deviceMemory.evictUnderPressure();
+    frameNumber++;
+    slotFrameNumbers[currentFrame] = frameNumber;
+    //a frame that had to evict always says so.
+    if(evicted > 0 || (memoryReportInterval != 0 && frameNumber % memoryReportInterval == 0))
+        deviceMemory.printBudget(std::clog, frameNumber);
+
+    LinearArena& arena = frameArenas[currentFrame];
+    arena.reset();
+    frameDescriptors[currentFrame].reset();
+    //one vkResetCommandPool per recording thread, recording threads take their buffers with acquire() after this.
+    frameCommands[currentFrame].reset();
+
+    //nothing is drawn yet, but the mesh pipeline is asked for the way a draw would, so it gets compiled in the
+    //background and goes into the manifest for the next session's warm up.
+    pipelineRegistry.find(meshPipelineState);
+
+    //everything built while recording the frame comes out of the arena so the frame never hits malloc/free.
+    FrameVector<VkCommandBuffer> commandBuffers{ArenaAllocator<VkCommandBuffer>(arena)};
+    commandBuffers.reserve(1);
+
+    VkCommandBuffer frameCommandBuffer = frameCommands[currentFrame].acquire(RENDER_THREAD);
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if(vkd.vkBeginCommandBuffer(frameCommandBuffer, &beginInfo) != VK_SUCCESS)
+        throw std::runtime_error("failed to begin recording the frame.");
+    //the heap is bound once for the whole command buffer, draws only push the indices of what they use.
+    if(bindless.available())
+    {
+        VkDescriptorSet heap = bindless.descriptorSet();
+        vkd.vkCmdBindDescriptorSets(frameCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, meshPipelineLayout, BINDLESS_SET, 1, &heap, 0, nullptr);
+    }
+    //push constants stay set for every mesh drawn after this in the command buffer.
+    MeshModel model = meshModel(state);
+    vkd.vkCmdPushConstants(frameCommandBuffer, meshPipelineLayout, meshReflection.stages, 0, sizeof(model), &model);
+    if(vkd.vkEndCommandBuffer(frameCommandBuffer) != VK_SUCCESS)
+        throw std::runtime_error("failed to record the frame.");
+    commandBuffers.push_back(frameCommandBuffer);
+
+    //every frame records at least its primary, the last submit marks the end of the frame on the timeline.
+    uint64_t frameValue = 0;
+    for(VkCommandBuffer commandBuffer : commandBuffers)
+        frameValue = submissionThread.enqueue(graphicsTimeline, commandBuffer);
+    submissionThread.flush();
+
+    slotTimelineValues[currentFrame] = frameValue;
+
+    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+}
+
 void initVulkan()
 {
     createInstance();
@@ -355,37 +788,235 @@ void initVulkan()
     createSurface();
     pickPhysicalDevice();
     createLogicalDevice();
+    createSyncObjects();
+    createDescriptorAllocators();
+    createCommandPools();
+    pipelineRegistry.init(device);
+    createMeshPipelineLayout();
+    //what the last session drew with gets compiled in the background while the rest starts up.
+    pipelineRegistry.warmUp(pipelineManifestPath);
+    createRenderTargets();
+    createMeshPipelineState();
+}
 
+//steps the simulation once per rendered frame at most SIMULATION_RATE times a second, a step only ever sees the input
+//as it was when the step began.
+void simulationLoop()
+{
+    using Clock = std::chrono::steady_clock;
+    const Clock::duration stepInterval = std::chrono::duration_cast<Clock::duration>(std::chrono::seconds(1)) / SIMULATION_RATE;
+    Clock::time_point start = Clock::now();
+    Clock::time_point previous = start;
+    Clock::time_point nextStep = start;
+    uint64_t step = 0;
+
+    while(RenderState* state = renderStates.beginWrite())
+    {
+        //a step that came late doesn't make the following ones hurry to catch up.
+        std::this_thread::sleep_until(nextStep);
+        Clock::time_point now = Clock::now();
+        nextStep = std::max(nextStep + stepInterval, now);
+        {
+            std::lock_guard<std::mutex> lock(inputMutex);
+            state->input = latestInput;
+        }
+
+        state->simulationFrame = ++step;
+        state->time = std::chrono::duration<double>(now - start).count();
+        state->deltaTime = std::chrono::duration<double>(now - previous).count();
+        previous = now;
+
+        renderStates.publish();
+    }
 }
 
-//the main program loop
-void mainLoop()
+//records and submits a frame for every snapshot the simulation publishes.
+void renderLoop()
 {
-    while (!glfwWindowShouldClose(window))
+    try
+    {
+        while(const RenderState* state = renderStates.acquire())
+        {
+            //everything allocated between these two calls counts against the frame.
+            allocationCounter.beginFrame();
+            drawFrame(*state);
+            allocationCounter.endFrame();
+            renderStates.release();
+        }
+    }
+    catch(...)
     {
-        glfwPollEvents();
+        renderFailure = std::current_exception();
+        renderStates.close();
+        //both are fine from any thread, the empty event wakes the main loop so it sees the window should close.
+        glfwSetWindowShouldClose(window, GLFW_TRUE);
+        glfwPostEmptyEvent();
     }
 }
 
+//the main program loop, the main thread only handles window events (GLFW wants that on the main thread) while the
+//simulation and the rendering run on threads of their own.
+void mainLoop()
+{
+    std::thread simulationThread(simulationLoop);
+    //without Vulkan there is no render thread, the simulation publishes one step and then waits until the window closes.
+    std::thread renderThread;
+    if(vulkanAvailable)
+        renderThread = std::thread(renderLoop);
+
+    //sleeps until something happens, input reaches the simulation through the callbacks.
+    while (!glfwWindowShouldClose(window))
+        glfwWaitEvents();
+
+    renderStates.close();
+    simulationThread.join();
+    if(renderThread.joinable())
+        renderThread.join();
+
+    if(renderFailure != nullptr)
+        std::rethrow_exception(renderFailure);
+}
+
 //cleanup when the program exits, (delete vulkan objects and destroy windows)
 void cleanup()
 {
-    vkDestroyDevice(device, nullptr);
+    if(!vulkanAvailable)
+    {
+        glfwTerminate();
+        return;
+    }
+
+    //let the frames that are still in flight finish before anything they use goes away.
+    submissionThread.stop();
+    graphicsTimeline.waitIdle();
+    renderTargets.printReport(std::clog);
+    renderTargets.retire(deletionQueue, frameNumber);
+    deletionQueue.flush(device);
+    staticSegments.printReport(std::clog);
+    staticSegments.destroy();
+    for(FrameCommandPools& pools : frameCommands)
+    {
+        pools.printReport(std::clog);
+        pools.destroy();
+    }
+    for(DescriptorAllocator& allocator : frameDescriptors)
+        allocator.destroy();
+    pipelineRegistry.printReport(std::clog);
+    pipelineRegistry.saveManifest(pipelineManifestPath);
+    pipelineRegistry.destroy();
+    meshDescriptors.destroy();
+    vkd.vkDestroyPipelineLayout(device, meshPipelineLayout, hostAllocator.callbacks());
+    bindless.printReport(std::clog);
+    bindless.destroy();
+    descriptorLayouts.destroy();
+    graphicsTimeline.destroy();
+
+    deviceMemory.printReport(std::clog);
+
+    vkd.vkDestroyDevice(device, hostAllocator.callbacks());
     if (enableValidationLayers)
-        DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
+        DestroyDebugUtilsMessengerEXT(instance, debugMessenger, hostAllocator.callbacks());
 
 
-    vkDestroySurfaceKHR(instance, surface, nullptr);
-    vkDestroyInstance(instance, nullptr);
+    vkd.vkDestroySurfaceKHR(instance, surface, hostAllocator.callbacks());
+    vkd.vkDestroyInstance(instance, hostAllocator.callbacks());
+    unloadVulkanLoader();
+
+    hostAllocator.printStats(std::clog);
+    allocationCounter.printSummary(std::clog);
 
     glfwTerminate();
 }
 
+//undoes what initVulkan() got done before it failed: the threads are stopped, then whatever was made on the device,
+//the device and the instance go in the same order cleanup() uses. every part is fine with being destroyed without
+//having been created.
+void abandonVulkan()
+{
+    try
+    {
+        submissionThread.stop();
+    }
+    catch(const std::exception&)
+    {
+    }
+    pipelineRegistry.destroy();
+
+    if(device != VK_NULL_HANDLE)
+    {
+        vkd.vkDeviceWaitIdle(device);
+        renderTargets.retire(deletionQueue, frameNumber);
+        deletionQueue.flush(device);
+        staticSegments.destroy();
+        for(FrameCommandPools& pools : frameCommands)
+            pools.destroy();
+        for(DescriptorAllocator& allocator : frameDescriptors)
+            allocator.destroy();
+        meshDescriptors.destroy();
+        vkd.vkDestroyPipelineLayout(device, meshPipelineLayout, hostAllocator.callbacks());
+        meshPipelineLayout = VK_NULL_HANDLE;
+        bindless.destroy();
+        descriptorLayouts.destroy();
+        graphicsTimeline.destroy();
+        vkd.vkDestroyDevice(device, hostAllocator.callbacks());
+        device = VK_NULL_HANDLE;
+    }
+
+    if(instance != VK_NULL_HANDLE)
+    {
+        if(debugMessenger != VK_NULL_HANDLE)
+            DestroyDebugUtilsMessengerEXT(instance, debugMessenger, hostAllocator.callbacks());
+        if(surface != VK_NULL_HANDLE)
+            vkd.vkDestroySurfaceKHR(instance, surface, hostAllocator.callbacks());
+        vkd.vkDestroyInstance(instance, hostAllocator.callbacks());
+    }
+    debugMessenger = VK_NULL_HANDLE;
+    surface = VK_NULL_HANDLE;
+    instance = VK_NULL_HANDLE;
+    unloadVulkanLoader();
+}
+
 //the program flow
 void run()
 {
+    //VECL_STRICT_ALLOCATIONS=1 prints a stack trace for every allocation made by a frame after warm up.
+    const char* strictAllocations = std::getenv("VECL_STRICT_ALLOCATIONS");
+    allocationCounter.setStrict(strictAllocations != nullptr && std::strcmp(strictAllocations, "0") != 0);
+
+    //VECL_PROBE_CACHE=path moves the device probe cache, it lives in the working directory otherwise.
+    const char* cachePath = std::getenv("VECL_PROBE_CACHE");
+    probeCachePath = cachePath != nullptr ? cachePath : "vecl_probe.cache";
+    //VECL_PIPELINE_MANIFEST=path does the same for the list of pipelines to warm up.
+    const char* manifestPath = std::getenv("VECL_PIPELINE_MANIFEST");
+    pipelineManifestPath = manifestPath != nullptr ? manifestPath : "vecl_pipelines.manifest";
+    //VECL_MEMORY_REPORT=N prints the memory budget every N frames (1 for every frame).
+    const char* memoryReport = std::getenv("VECL_MEMORY_REPORT");
+    memoryReportInterval = memoryReport != nullptr ? std::strtoull(memoryReport, nullptr, 10) : 0;
+
     initWindow();
-    initVulkan();
+
+    //Vulkan is only looked for now, if the loader isn't installed or there is no usable instance or GPU keep running
+    //without a renderer instead of failing to start.
+    vulkanAvailable = loadVulkanLoader();
+    if(!vulkanAvailable)
+        std::cerr<<"No Vulkan loader found (tried the system libvulkan), running without rendering."<<std::endl;
+    else
+    {
+        probeCache.load(probeCachePath);
+        try
+        {
+            initVulkan();
+        }
+        catch(const std::exception& error)
+        {
+            std::cerr<<"Vulkan failed to start ("<<error.what()<<"), running without rendering."<<std::endl;
+            abandonVulkan();
+            vulkanAvailable = false;
+        }
+    }
+    if(!vulkanAvailable)
+        glfwSetWindowTitle(window, "Vulkan (unavailable)");
+
     mainLoop();
     cleanup();
 }
@@ -0,0 +1,27 @@
+#version 450
+
+//variant options (MeshVariants in main.cpp), each combination is compiled with them folded in.
+layout(constant_id = 0) const bool ALBEDO_TEXTURE = true;
+//0 unlit, 1 lambert, 2 wrapped lambert with a rim.
+layout(constant_id = 1) const uint QUALITY = 1;
+
+layout(set = 0, binding = 1) uniform sampler2D albedo;
+
+layout(location = 0) in vec3 worldNormal;
+layout(location = 1) in vec2 texCoord;
+
+layout(location = 0) out vec4 color;
+
+void main()
+{
+    vec3 base = ALBEDO_TEXTURE ? texture(albedo, texCoord).rgb : vec3(0.8);
+    vec3 normal = normalize(worldNormal);
+    vec3 lightDirection = normalize(vec3(0.3, 1.0, 0.5));
+
+    float light = 1.0;
+    if(QUALITY == 1)
+        light = max(dot(normal, lightDirection), 0.1);
+    else if(QUALITY == 2)
+        light = (dot(normal, lightDirection) * 0.5 + 0.5) + pow(1.0 - abs(normal.z), 4.0) * 0.25;
+    color = vec4(base * light, 1.0);
+}
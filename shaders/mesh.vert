@@ -0,0 +1,26 @@
+#version 450
+
+//set 0 is filled from MeshDescriptors in main.cpp, the build checks that the two agree.
+layout(set = 0, binding = 0) uniform Camera
+{
+    mat4 viewProjection;
+} camera;
+
+layout(push_constant) uniform Draw
+{
+    mat4 model;
+} draw;
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 uv;
+
+layout(location = 0) out vec3 worldNormal;
+layout(location = 1) out vec2 texCoord;
+
+void main()
+{
+    gl_Position = camera.viewProjection * draw.model * vec4(position, 1.0);
+    worldNormal = mat3(draw.model) * normal;
+    texCoord = uv;
+}